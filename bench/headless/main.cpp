@@ -0,0 +1,8 @@
+#include "Benchmark.h"
+
+//========================================================================
+// Headless runner of the core benchmarks, built by CMakeLists.txt with
+// PHASECONGRUENCY_BENCH. The wrapper benchmarks need the oF app in src/.
+int main(int argc, char** argv){
+	return bench::runBenchmarks(argc, argv);
+}
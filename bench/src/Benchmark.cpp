@@ -0,0 +1,437 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <regex>
+#include <sstream>
+#include <thread>
+
+namespace bench
+{
+
+static double processCpuSeconds()
+{
+    return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+}
+
+State::State(int64_t iterations, const std::vector<int64_t>& args) : args(args), maxIterations(iterations)
+{
+}
+
+bool State::Iterator::operator!=(const Iterator& other) const
+{
+    if (remaining != other.remaining)
+        return true;
+    state->stopTimer();
+    return false;
+}
+
+State::Iterator State::begin()
+{
+    startTimer();
+    return Iterator{ this, maxIterations };
+}
+
+void State::PauseTiming()
+{
+    stopTimer();
+}
+
+void State::ResumeTiming()
+{
+    startTimer();
+}
+
+void State::startTimer()
+{
+    if (running)
+        return;
+    running = true;
+    realStart = Clock::now();
+    cpuStart = processCpuSeconds();
+}
+
+void State::stopTimer()
+{
+    if (!running)
+        return;
+    running = false;
+    realSeconds += std::chrono::duration<double>(Clock::now() - realStart).count();
+    cpuSeconds += processCpuSeconds() - cpuStart;
+}
+
+Benchmark* Benchmark::ArgsProduct(const std::vector<std::vector<int64_t>>& lists)
+{
+    std::vector<std::vector<int64_t>> product(1);
+    for (const auto& list : lists)
+    {
+        std::vector<std::vector<int64_t>> next;
+        for (const auto& prefix : product)
+        {
+            for (int64_t value : list)
+            {
+                next.push_back(prefix);
+                next.back().push_back(value);
+            }
+        }
+        product.swap(next);
+    }
+    argSets.insert(argSets.end(), product.begin(), product.end());
+    return this;
+}
+
+static std::vector<std::unique_ptr<Benchmark>>& registry()
+{
+    static std::vector<std::unique_ptr<Benchmark>> benchmarks;
+    return benchmarks;
+}
+
+Benchmark* registerBenchmark(const std::string& name, std::function<void(State&)> fn)
+{
+    registry().emplace_back(new Benchmark(name, fn));
+    return registry().back().get();
+}
+
+// One measured run, or an aggregate of the repetitions of a run
+struct Result
+{
+    std::string name;
+    std::string runName;
+    std::string aggregate;  // "", "mean", "median", "stddev"
+    int repetitions = 1;
+    int repetitionIndex = 0;
+    int64_t iterations = 0;
+    double realTime = 0;    // per iteration, in unit
+    double cpuTime = 0;
+    std::string unit;
+    std::string label;
+    double itemsPerSecond = 0;
+    double bytesPerSecond = 0;
+    std::map<std::string, double> counters;
+};
+
+static double unitScale(const std::string& unit)
+{
+    if (unit == "ns")
+        return 1e9;
+    if (unit == "us")
+        return 1e6;
+    if (unit == "s")
+        return 1.0;
+    return 1e3;
+}
+
+static std::string jsonEscape(const std::string& text)
+{
+    std::string out;
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+class Runner
+{
+public:
+    double minTime = 0.5;
+    int repetitions = 1;
+
+    std::vector<Result> run(Benchmark& benchmark, const std::vector<int64_t>& args, const std::string& runName)
+    {
+        // Grow the iteration count until one run lasts minTime
+        int64_t iterations = benchmark.fixedIterations > 0 ? benchmark.fixedIterations : 1;
+        State probe(iterations, args);
+        benchmark.fn(probe);
+        while (benchmark.fixedIterations == 0 && probe.realSeconds < minTime && iterations < 1000000000)
+        {
+            const double perIteration = std::max(probe.realSeconds / iterations, 1e-9);
+            const int64_t next = static_cast<int64_t>(std::ceil(1.4 * minTime / perIteration));
+            iterations = std::max(iterations + 1, std::min(next, iterations * 10));
+            probe = State(iterations, args);
+            benchmark.fn(probe);
+        }
+
+        std::vector<Result> results;
+        for (int rep = 0; rep < repetitions; rep++)
+        {
+            State state(iterations, args);
+            if (rep == 0 && repetitions == 1)
+                state = probe;
+            else
+                benchmark.fn(state);
+            results.push_back(toResult(benchmark, state, runName, rep));
+        }
+        if (repetitions > 1)
+            aggregate(results);
+        return results;
+    }
+
+private:
+    Result toResult(const Benchmark& benchmark, const State& state, const std::string& runName, int rep) const
+    {
+        Result r;
+        r.name = runName;
+        r.runName = runName;
+        r.repetitions = repetitions;
+        r.repetitionIndex = rep;
+        r.iterations = state.maxIterations;
+        r.unit = benchmark.unit;
+        const double scale = unitScale(r.unit);
+        r.realTime = state.realSeconds / state.maxIterations * scale;
+        r.cpuTime = state.cpuSeconds / state.maxIterations * scale;
+        r.label = state.label;
+        if (state.realSeconds > 0)
+        {
+            r.itemsPerSecond = state.itemsProcessed / state.realSeconds;
+            r.bytesPerSecond = state.bytesProcessed / state.realSeconds;
+        }
+        r.counters = state.counters;
+        return r;
+    }
+
+    static void aggregate(std::vector<Result>& results)
+    {
+        const size_t n = results.size();
+        std::vector<double> real, cpu;
+        for (size_t i = 0; i < n; i++)
+        {
+            real.push_back(results[i].realTime);
+            cpu.push_back(results[i].cpuTime);
+        }
+
+        auto mean = [](const std::vector<double>& v) {
+            double sum = 0;
+            for (double x : v)
+                sum += x;
+            return sum / v.size();
+        };
+        auto median = [](std::vector<double> v) {
+            std::sort(v.begin(), v.end());
+            return v.size() % 2 ? v[v.size() / 2] : 0.5 * (v[v.size() / 2 - 1] + v[v.size() / 2]);
+        };
+        auto stddev = [&](const std::vector<double>& v) {
+            const double m = mean(v);
+            double sum = 0;
+            for (double x : v)
+                sum += (x - m) * (x - m);
+            return v.size() > 1 ? std::sqrt(sum / (v.size() - 1)) : 0.0;
+        };
+
+        const Result base = results[0];
+        const char* names[] = { "mean", "median", "stddev" };
+        const double realStats[] = { mean(real), median(real), stddev(real) };
+        const double cpuStats[] = { mean(cpu), median(cpu), stddev(cpu) };
+        for (int i = 0; i < 3; i++)
+        {
+            Result r = base;
+            r.aggregate = names[i];
+            r.name = base.runName + "_" + names[i];
+            r.realTime = realStats[i];
+            r.cpuTime = cpuStats[i];
+            results.push_back(r);
+        }
+    }
+};
+
+static void writeConsoleHeader(std::ostream& out)
+{
+    out << std::left << std::setw(56) << "Benchmark" << std::right << std::setw(14) << "Time"
+        << std::setw(14) << "CPU" << std::setw(12) << "Iterations" << "\n";
+    out << std::string(96, '-') << "\n";
+}
+
+static void writeConsole(std::ostream& out, const std::vector<Result>& results)
+{
+    for (const Result& r : results)
+    {
+        out << std::left << std::setw(56) << r.name << std::right << std::fixed << std::setprecision(3)
+            << std::setw(11) << r.realTime << " " << std::setw(2) << r.unit
+            << std::setw(11) << r.cpuTime << " " << std::setw(2) << r.unit
+            << std::setw(12) << r.iterations;
+        for (const auto& counter : r.counters)
+            out << " " << counter.first << "=" << std::setprecision(4) << counter.second;
+        if (!r.label.empty())
+            out << " " << r.label;
+        out << "\n";
+    }
+}
+
+static void writeJson(std::ostream& out, const std::vector<Result>& results)
+{
+    const std::time_t now = std::time(nullptr);
+    char date[64];
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+    out << "{\n  \"context\": {\n"
+        << "    \"date\": \"" << date << "\",\n"
+        << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+#ifdef NDEBUG
+        << "    \"library_build_type\": \"release\"\n"
+#else
+        << "    \"library_build_type\": \"debug\"\n"
+#endif
+        << "  },\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const Result& r = results[i];
+        out << "    {\n"
+            << "      \"name\": \"" << jsonEscape(r.name) << "\",\n"
+            << "      \"run_name\": \"" << jsonEscape(r.runName) << "\",\n"
+            << "      \"run_type\": \"" << (r.aggregate.empty() ? "iteration" : "aggregate") << "\",\n";
+        if (!r.aggregate.empty())
+            out << "      \"aggregate_name\": \"" << r.aggregate << "\",\n";
+        out << "      \"repetitions\": " << r.repetitions << ",\n"
+            << "      \"repetition_index\": " << r.repetitionIndex << ",\n"
+            << "      \"iterations\": " << r.iterations << ",\n"
+            << std::setprecision(9)
+            << "      \"real_time\": " << r.realTime << ",\n"
+            << "      \"cpu_time\": " << r.cpuTime << ",\n"
+            << "      \"time_unit\": \"" << r.unit << "\"";
+        if (r.itemsPerSecond > 0)
+            out << ",\n      \"items_per_second\": " << r.itemsPerSecond;
+        if (r.bytesPerSecond > 0)
+            out << ",\n      \"bytes_per_second\": " << r.bytesPerSecond;
+        for (const auto& counter : r.counters)
+            out << ",\n      \"" << jsonEscape(counter.first) << "\": " << counter.second;
+        if (!r.label.empty())
+            out << ",\n      \"label\": \"" << jsonEscape(r.label) << "\"";
+        out << "\n    }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+static void writeCsv(std::ostream& out, const std::vector<Result>& results)
+{
+    // Counter columns are the union over all runs
+    std::vector<std::string> counterNames;
+    for (const Result& r : results)
+        for (const auto& counter : r.counters)
+            if (std::find(counterNames.begin(), counterNames.end(), counter.first) == counterNames.end())
+                counterNames.push_back(counter.first);
+
+    out << "name,iterations,real_time,cpu_time,time_unit,bytes_per_second,items_per_second,label";
+    for (const std::string& name : counterNames)
+        out << "," << name;
+    out << "\n";
+    for (const Result& r : results)
+    {
+        out << "\"" << r.name << "\"," << r.iterations << "," << std::setprecision(9) << r.realTime << ","
+            << r.cpuTime << "," << r.unit << ",";
+        if (r.bytesPerSecond > 0)
+            out << r.bytesPerSecond;
+        out << ",";
+        if (r.itemsPerSecond > 0)
+            out << r.itemsPerSecond;
+        out << ",\"" << r.label << "\"";
+        for (const std::string& name : counterNames)
+        {
+            out << ",";
+            auto it = r.counters.find(name);
+            if (it != r.counters.end())
+                out << it->second;
+        }
+        out << "\n";
+    }
+}
+
+static void write(std::ostream& out, const std::string& format, const std::vector<Result>& results)
+{
+    if (format == "json")
+        writeJson(out, results);
+    else if (format == "csv")
+        writeCsv(out, results);
+    else
+    {
+        writeConsoleHeader(out);
+        writeConsole(out, results);
+    }
+}
+
+int runBenchmarks(int argc, char** argv)
+{
+    std::string filter = ".";
+    std::string format = "console";
+    std::string outPath;
+    std::string outFormat = "json";
+    Runner runner;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const size_t eq = arg.find('=');
+        const std::string flag = arg.substr(0, eq);
+        const std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        if (flag == "--benchmark_filter")
+            filter = value;
+        else if (flag == "--benchmark_format")
+            format = value;
+        else if (flag == "--benchmark_out")
+            outPath = value;
+        else if (flag == "--benchmark_out_format")
+            outFormat = value;
+        else if (flag == "--benchmark_min_time")
+            runner.minTime = std::stod(value);
+        else if (flag == "--benchmark_repetitions")
+            runner.repetitions = std::max(1, std::stoi(value));
+        else
+        {
+            std::cerr << "unknown flag " << arg << "\n";
+            return 1;
+        }
+    }
+
+    const std::regex pattern(filter);
+    std::vector<Result> results;
+    if (format == "console")
+        writeConsoleHeader(std::cout);
+    for (const auto& benchmark : registry())
+    {
+        std::vector<std::vector<int64_t>> argSets = benchmark->argSets;
+        if (argSets.empty())
+            argSets.push_back(std::vector<int64_t>());
+
+        for (const auto& args : argSets)
+        {
+            std::ostringstream runName;
+            runName << benchmark->name;
+            for (size_t a = 0; a < args.size(); a++)
+            {
+                runName << "/";
+                if (a < benchmark->argNames.size())
+                    runName << benchmark->argNames[a] << ":";
+                runName << args[a];
+            }
+            if (!std::regex_search(runName.str(), pattern))
+                continue;
+
+            const std::vector<Result> runResults = runner.run(*benchmark, args, runName.str());
+            if (format == "console")
+                writeConsole(std::cout, runResults);
+            results.insert(results.end(), runResults.begin(), runResults.end());
+        }
+    }
+
+    if (format != "console")
+        write(std::cout, format, results);
+    if (!outPath.empty())
+    {
+        std::ofstream out(outPath);
+        if (!out)
+        {
+            std::cerr << "cannot write " << outPath << "\n";
+            return 1;
+        }
+        write(out, outFormat, results);
+    }
+    return 0;
+}
+
+} // namespace bench
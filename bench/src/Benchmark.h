@@ -0,0 +1,117 @@
+#pragma once
+
+// Minimal benchmark harness modelled on Google Benchmark: the same
+// registration style, `for (auto _ : state)` loops, command-line flags and
+// JSON layout, so results can go through the usual comparison tools.
+//
+//   static void BM_Thing(bench::State& state) {
+//       Thing thing(state.range(0));
+//       for (auto _ : state)
+//           thing.run();
+//   }
+//   PC_BENCHMARK(BM_Thing)->ArgNames({"size"})->Args({256})->Args({512});
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace bench
+{
+
+class State
+{
+public:
+    State(int64_t iterations, const std::vector<int64_t>& args);
+
+    int64_t range(size_t index) const { return args[index]; }
+    int64_t iterations() const { return maxIterations; }
+
+    // Exclude setup work inside the loop from the measurement
+    void PauseTiming();
+    void ResumeTiming();
+
+    void SetLabel(const std::string& text) { label = text; }
+    void SetItemsProcessed(int64_t items) { itemsProcessed = items; }
+    void SetBytesProcessed(int64_t bytes) { bytesProcessed = bytes; }
+
+    // User counters, reported per run
+    std::map<std::string, double> counters;
+
+    // Loop variable of `for (auto _ : state)`; non-trivial so that it does
+    // not trigger unused-variable warnings
+    struct Value
+    {
+        ~Value() {}
+    };
+
+    struct Iterator
+    {
+        State* state;
+        int64_t remaining;
+        bool operator!=(const Iterator& other) const;
+        Iterator& operator++() { --remaining; return *this; }
+        Value operator*() const { return Value(); }
+    };
+    Iterator begin();
+    Iterator end() { return Iterator{ this, 0 }; }
+
+private:
+    friend class Runner;
+    typedef std::chrono::steady_clock Clock;
+
+    void startTimer();
+    void stopTimer();
+
+    std::vector<int64_t> args;
+    int64_t maxIterations;
+    bool running = false;
+    Clock::time_point realStart;
+    double cpuStart = 0;
+    double realSeconds = 0;
+    double cpuSeconds = 0;
+    std::string label;
+    int64_t itemsProcessed = 0;
+    int64_t bytesProcessed = 0;
+};
+
+class Benchmark
+{
+public:
+    Benchmark(const std::string& name, std::function<void(State&)> fn) : name(name), fn(fn) {}
+
+    Benchmark* Args(const std::vector<int64_t>& values) { argSets.push_back(values); return this; }
+    Benchmark* ArgNames(const std::vector<std::string>& names) { argNames = names; return this; }
+    // Cartesian product of the given value lists
+    Benchmark* ArgsProduct(const std::vector<std::vector<int64_t>>& lists);
+    Benchmark* Iterations(int64_t n) { fixedIterations = n; return this; }
+    Benchmark* Unit(const std::string& timeUnit) { unit = timeUnit; return this; }
+
+private:
+    friend class Runner;
+    friend int runBenchmarks(int argc, char** argv);
+    std::string name;
+    std::function<void(State&)> fn;
+    std::vector<std::vector<int64_t>> argSets;
+    std::vector<std::string> argNames;
+    int64_t fixedIterations = 0;
+    std::string unit = "ms";
+};
+
+Benchmark* registerBenchmark(const std::string& name, std::function<void(State&)> fn);
+
+// Runs every registered benchmark matching --benchmark_filter and reports
+// them. Flags: --benchmark_filter=<regex>, --benchmark_min_time=<s>,
+// --benchmark_repetitions=<n>, --benchmark_format=<console|json|csv>,
+// --benchmark_out=<file>, --benchmark_out_format=<json|csv>.
+// Returns the process exit status.
+int runBenchmarks(int argc, char** argv);
+
+} // namespace bench
+
+#define PC_BENCHMARK_CONCAT2(a, b) a##b
+#define PC_BENCHMARK_CONCAT(a, b) PC_BENCHMARK_CONCAT2(a, b)
+#define PC_BENCHMARK(fn) \
+    static bench::Benchmark* PC_BENCHMARK_CONCAT(benchmark_, __LINE__) = bench::registerBenchmark(#fn, fn)
@@ -0,0 +1,346 @@
+#include "Benchmark.h"
+#include "PhaseCongruencyBenchmarks.h"
+#include "PhaseCongruencyKernels.h"
+
+// Stage benchmarks of the phase congruency core. They use only
+// PhaseCongruency and OpenCV, so they also build headless (CMakeLists.txt,
+// PHASECONGRUENCY_BENCH); see PhaseCongruencyBenchmarks.h for the arguments.
+
+// The FFT backends compiled into this build
+static std::vector<int64_t> fftBackends()
+{
+    std::vector<int64_t> backends;
+    for (int b : { PC_FFT_OPENCV, PC_FFT_FFTW, PC_FFT_POCKETFFT })
+        if (PhaseCongruencyFFT::available(static_cast<PhaseCongruencyFFTBackend>(b)))
+            backends.push_back(b);
+    return backends;
+}
+
+static cv::Mat randomPlane(int rows, int cols, int depth, uint64 seed)
+{
+    cv::Mat plane(rows, cols, CV_MAKETYPE(depth, 1));
+    cv::RNG rng(seed);
+    rng.fill(plane, cv::RNG::NORMAL, 0.0, 1.0);
+    return plane;
+}
+
+// Cold filter bank construction: the bank cache is cleared before every
+// constructor call
+static void BM_FilterConstruction(bench::State& state)
+{
+    const int size = static_cast<int>(state.range(0));
+    const size_t nscale = static_cast<size_t>(state.range(1));
+    const size_t norient = static_cast<size_t>(state.range(2));
+    const int depth = cvDepth(state.range(3));
+    PhaseCongruency::setFilterCacheDirectory("");
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        PhaseCongruency::clearFilterCache();
+        state.ResumeTiming();
+        PhaseCongruency pc(cv::Size(size, size), nscale, norient, depth);
+    }
+}
+PC_BENCHMARK(BM_FilterConstruction)
+    ->ArgNames({ "size", "nscale", "norient", "depth" })
+    ->ArgsProduct({ sizes, { 4 }, { 6 }, depths })
+    ->ArgsProduct({ { 512 }, { 3, 5 }, { 4, 8 }, { 64 } });
+
+// Planned transform of the padded frame and its scratch buffer for count
+// planes; planning (FFTW_MEASURE for FFTW) happens here, outside the timed
+// loop
+static std::shared_ptr<const PhaseCongruencyFFT> plannedFFT(bench::State& state, cv::Mat& scratch, int count = 1)
+{
+    const int size = cv::getOptimalDFTSize(static_cast<int>(state.range(0)));
+    const int depth = cvDepth(state.range(1));
+    const PhaseCongruencyFFTBackend backend = static_cast<PhaseCongruencyFFTBackend>(state.range(2));
+    std::shared_ptr<const PhaseCongruencyFFT> fft = PhaseCongruencyFFT::acquire(backend, size, size, depth);
+    const cv::Size scratchSize = fft->scratchSize(count);
+    if (!scratchSize.empty())
+        scratch.create(scratchSize, CV_MAKETYPE(depth, 2));
+    if (count > 1)
+    {
+        // The batched plan is made on first use
+        cv::Mat planes(count * size, size, CV_MAKETYPE(depth, 1), cv::Scalar(0)), response(planes.size(), planes.type());
+        fft->inverseMany(planes, response, count, scratch);
+    }
+    state.SetLabel(PhaseCongruencyFFT::name(backend));
+    return fft;
+}
+
+// Forward real DFT of the padded frame
+static void BM_ForwardDFT(bench::State& state)
+{
+    cv::Mat scratch;
+    std::shared_ptr<const PhaseCongruencyFFT> fft = plannedFFT(state, scratch);
+    cv::Mat padded = randomPlane(fft->size().height, fft->size().width, cvDepth(state.range(1)), 1);
+    cv::Mat spectrum;
+
+    for (auto _ : state)
+        fft->forward(padded, spectrum, scratch);
+    state.SetItemsProcessed(state.iterations());
+}
+PC_BENCHMARK(BM_ForwardDFT)->ArgNames({ "size", "depth", "backend" })->ArgsProduct({ sizes, depths, fftBackends() })->Unit("us");
+
+// One inverse real DFT; calc runs 2 * nscale * norient of them per frame
+static void BM_InverseDFT(bench::State& state)
+{
+    cv::Mat scratch;
+    std::shared_ptr<const PhaseCongruencyFFT> fft = plannedFFT(state, scratch);
+    cv::Mat spectrum;
+    cv::dft(randomPlane(fft->size().height, fft->size().width, cvDepth(state.range(1)), 2), spectrum);
+    cv::Mat response;
+
+    for (auto _ : state)
+        fft->inverse(spectrum, response, scratch);
+    state.SetItemsProcessed(state.iterations());
+}
+PC_BENCHMARK(BM_InverseDFT)->ArgNames({ "size", "depth", "backend" })->ArgsProduct({ sizes, depths, fftBackends() })->Unit("us");
+
+// planes stacked inverses in one batched transform, as each worker of calc
+// runs them; items are planes, to compare with BM_InverseDFT
+static void BM_InverseDFTBatch(bench::State& state)
+{
+    const int planes = static_cast<int>(state.range(3));
+    cv::Mat scratch;
+    std::shared_ptr<const PhaseCongruencyFFT> fft = plannedFFT(state, scratch, planes);
+    const int rows = fft->size().height;
+    cv::Mat spectra(planes * rows, fft->size().width, fft->type());
+    for (int i = 0; i < planes; i++)
+    {
+        cv::Mat plane = spectra.rowRange(i * rows, (i + 1) * rows);
+        cv::dft(randomPlane(rows, fft->size().width, cvDepth(state.range(1)), 2 + i), plane);
+    }
+    cv::Mat responses(spectra.size(), spectra.type());
+
+    for (auto _ : state)
+        fft->inverseMany(spectra, responses, planes, scratch);
+    state.SetItemsProcessed(state.iterations() * planes);
+}
+PC_BENCHMARK(BM_InverseDFTBatch)
+    ->ArgNames({ "size", "depth", "backend", "planes" })
+    ->ArgsProduct({ sizes, depths, fftBackends(), { 2, 8 } })
+    ->Unit("us");
+
+// Largest difference between the vectorized kernels (AVX2 / AVX-512 in
+// builds compiled for them) and their scalar path on fixed random planes,
+// relative to the largest output value. Scalar builds compare the scalar
+// path with itself.
+template<typename T>
+static double kernelDifference(int width, int nscale, int norient)
+{
+    typedef pckernel::ScalarOps<T> Scalar;
+    std::vector<cv::Mat> planes;
+    std::vector<const T*> rows;
+    for (int p = 0; p < 2 * std::max(nscale, norient); p++)
+    {
+        planes.push_back(randomPlane(1, width, cv::DataType<T>::depth, 100 + p));
+        rows.push_back(planes.back().ptr<T>(0));
+    }
+    const int type = cv::DataType<T>::type;
+    cv::Mat vec(6, width, type), ref(6, width, type);
+
+    double diff = 0, scale = 0;
+    auto compare = [&](int first, int count) {
+        for (int r = first; r < first + count; r++)
+        {
+            diff = std::max(diff, cv::norm(vec.row(r), ref.row(r), cv::NORM_INF));
+            scale = std::max(scale, cv::norm(ref.row(r), cv::NORM_INF));
+        }
+    };
+
+    pckernel::energyRow<T>(rows.data(), rows.data() + nscale, nscale, width, T(0.1), T(0.0002), T(0.4), T(10),
+                           vec.ptr<T>(0), vec.ptr<T>(1), vec.ptr<T>(2));
+    for (int x = 0; x < width; x++)
+        pckernel::energyPixels<T, Scalar>(rows.data(), rows.data() + nscale, nscale, x, T(0.1), T(0.0002), T(0.4), T(10),
+                                          ref.ptr<T>(0), ref.ptr<T>(1), ref.ptr<T>(2));
+    compare(0, 3);
+
+    std::vector<T> wx2(norient), wy2(norient), wxy(norient);
+    for (int o = 0; o < norient; o++)
+    {
+        const double angl = o * CV_PI / norient;
+        wx2[o] = T(cos(angl) * cos(angl) * 2.0 / norient);
+        wy2[o] = T(sin(angl) * sin(angl) * 2.0 / norient);
+        wxy[o] = T(cos(angl) * sin(angl) * 4.0 / norient);
+    }
+    pckernel::momentRow<T>(rows.data(), norient, wx2.data(), wy2.data(), wxy.data(), width,
+                           vec.ptr<T>(3), vec.ptr<T>(4));
+    for (int x = 0; x < width; x++)
+        pckernel::momentPixels<T, Scalar>(rows.data(), norient, wx2.data(), wy2.data(), wxy.data(), x,
+                                          ref.ptr<T>(3), ref.ptr<T>(4));
+    compare(3, 2);
+
+    double sum = 0;
+    for (int x = 0; x < width; x++)
+        sum += std::sqrt(static_cast<double>(rows[0][x]) * rows[0][x] + static_cast<double>(rows[1][x]) * rows[1][x]);
+    diff = std::max(diff, std::abs(pckernel::magnitudeSum<T>(rows[0], rows[1], width) - sum) / width);
+
+    return scale > 0 ? diff / scale : diff;
+}
+
+// The per-orientation energy loop of calc: fused energy, exp and weighting
+// over nscale even/odd responses. kernel_diff is kernelDifference; the run
+// fails if it is above rounding level for the depth.
+template<typename T>
+static void energyLoop(bench::State& state)
+{
+    const int size = static_cast<int>(state.range(0));
+    const int nscale = static_cast<int>(state.range(1));
+    std::vector<cv::Mat> re, im;
+    for (int s = 0; s < nscale; s++)
+    {
+        re.push_back(randomPlane(size, size, cv::DataType<T>::depth, 10 + s));
+        im.push_back(randomPlane(size, size, cv::DataType<T>::depth, 20 + s));
+    }
+    cv::Mat energy(size, size, cv::DataType<T>::type);
+    cv::Mat arg(1, size, cv::DataType<T>::type);
+    cv::Mat sumAn(1, size, cv::DataType<T>::type);
+    std::vector<const T*> rows(2 * nscale);
+
+    for (auto _ : state)
+    {
+        for (int y = 0; y < size; y++)
+        {
+            for (int s = 0; s < nscale; s++)
+            {
+                rows[s] = re[s].ptr<T>(y);
+                rows[nscale + s] = im[s].ptr<T>(y);
+            }
+            pckernel::energyRow<T>(rows.data(), rows.data() + nscale, nscale, size, T(0.1), T(0.0002), T(0.4), T(10),
+                                   energy.ptr<T>(y), arg.ptr<T>(0), sumAn.ptr<T>(0));
+            cv::exp(arg, arg);
+            pckernel::weightRow<T>(energy.ptr<T>(y), arg.ptr<T>(0), sumAn.ptr<T>(0), size);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * size * size);
+
+    // Odd width so that every vector width also runs its scalar tail
+    const double diff = kernelDifference<T>(size + 3, nscale, 6);
+    state.counters["kernel_diff"] = diff;
+    CV_Assert(diff <= (sizeof(T) == 4 ? 1e-5 : 1e-12));
+}
+
+static void BM_EnergyLoop(bench::State& state)
+{
+    if (state.range(2) == 32)
+        energyLoop<float>(state);
+    else
+        energyLoop<double>(state);
+}
+PC_BENCHMARK(BM_EnergyLoop)->ArgNames({ "size", "nscale", "depth" })->ArgsProduct({ sizes, { 4 }, depths });
+
+// calc: forward DFT, filtering, inverse DFTs and energy for all orientations
+static void BM_Calc(bench::State& state)
+{
+    const int size = static_cast<int>(state.range(0));
+    PhaseCongruency pc(cv::Size(size, size), state.range(1), state.range(2), cvDepth(state.range(3)));
+    pc.setNumThreads(static_cast<int>(state.range(4)));
+    const cv::Mat image = testImage(size);
+    std::vector<cv::Mat> maps;
+    pc.calc(image, maps);
+
+    for (auto _ : state)
+        pc.calc(image, maps);
+    state.counters["inverse_dfts"] = 2.0 * state.range(1) * state.range(2);
+}
+PC_BENCHMARK(BM_Calc)
+    ->ArgNames({ "size", "nscale", "norient", "depth", "threads" })
+    ->ArgsProduct({ sizes, { 4 }, { 6 }, depths, { 1, 0 } })
+    ->ArgsProduct({ { 512 }, { 3, 5 }, { 4, 8 }, { 64 }, { 1, 2, 4, 0 } });
+
+// calc with each FFT backend, all workers
+static void BM_CalcBackend(bench::State& state)
+{
+    const int size = static_cast<int>(state.range(0));
+    const PhaseCongruencyFFTBackend backend = static_cast<PhaseCongruencyFFTBackend>(state.range(2));
+    PhaseCongruency pc(cv::Size(size, size), 4, 6, cvDepth(state.range(1)));
+    pc.setFFTBackend(backend);
+    const cv::Mat image = testImage(size);
+    std::vector<cv::Mat> maps;
+    pc.calc(image, maps);
+
+    for (auto _ : state)
+        pc.calc(image, maps);
+    state.SetLabel(PhaseCongruencyFFT::name(backend));
+}
+PC_BENCHMARK(BM_CalcBackend)
+    ->ArgNames({ "size", "depth", "backend" })
+    ->ArgsProduct({ { 512, 1024 }, depths, fftBackends() });
+
+// feature on precomputed phase congruency maps: covariance, moments, 8-bit
+static void BM_Moments(bench::State& state)
+{
+    const int size = static_cast<int>(state.range(0));
+    PhaseCongruency pc(cv::Size(size, size), 4, state.range(1), cvDepth(state.range(2)));
+    pc.setNumThreads(static_cast<int>(state.range(3)));
+    std::vector<cv::Mat> maps;
+    pc.calc(testImage(size), maps);
+    cv::Mat edges, corners;
+
+    for (auto _ : state)
+        pc.feature(maps, edges, corners);
+}
+PC_BENCHMARK(BM_Moments)
+    ->ArgNames({ "size", "norient", "depth", "threads" })
+    ->ArgsProduct({ sizes, { 6 }, depths, { 1, 0 } });
+
+// feature on an image: calc plus moments. allocations counts workspace
+// reallocations after the first frame and must stay 0; allocations made
+// inside OpenCV are not counted.
+static void BM_Feature(bench::State& state)
+{
+    const int size = static_cast<int>(state.range(0));
+    PhaseCongruency pc(cv::Size(size, size), state.range(1), state.range(2), cvDepth(state.range(3)));
+    pc.setNumThreads(static_cast<int>(state.range(4)));
+    const cv::Mat image = testImage(size);
+    cv::Mat edges, corners;
+    pc.feature(image, edges, corners);
+    const size_t allocations = pc.workspaceAllocations();
+
+    for (auto _ : state)
+        pc.feature(image, edges, corners);
+    state.SetItemsProcessed(state.iterations());
+    state.counters["allocations"] = static_cast<double>(pc.workspaceAllocations() - allocations);
+    CV_Assert(pc.workspaceAllocations() == allocations);
+}
+PC_BENCHMARK(BM_Feature)
+    ->ArgNames({ "size", "nscale", "norient", "depth", "threads" })
+    ->ArgsProduct({ sizes, { 4 }, { 6 }, depths, { 1, 2, 4, 0 } });
+
+// featureTiled on a size x size image in 128-pixel tile cores. max_diff and
+// mean_diff compare the stitched edges with a whole-frame feature of the
+// image, away from the image border where the whole frame is zero-padded
+// and the tiles are mirrored; seams between tiles show up there.
+static void BM_FeatureTiled(bench::State& state)
+{
+    const int size = static_cast<int>(state.range(0));
+    const int depth = cvDepth(state.range(1));
+    const int overlap = PhaseCongruency::tileOverlap(4, PhaseCongruencyConst());
+    const int tile = 128 + 2 * overlap;
+    PhaseCongruency pc(cv::Size(tile, tile), 4, 6, depth);
+    pc.setNumThreads(static_cast<int>(state.range(2)));
+    const cv::Mat image = testImage(size);
+    cv::Mat edges(size, size, CV_8UC1), corners(size, size, CV_8UC1);
+    auto read = [&](const cv::Rect& region, cv::Mat& dst) { dst = image(region); };
+    auto write = [&](const cv::Rect& region, const cv::Mat& e, const cv::Mat& c) {
+        e.copyTo(edges(region));
+        c.copyTo(corners(region));
+    };
+
+    for (auto _ : state)
+        pc.featureTiled(image.size(), read, write);
+    state.SetItemsProcessed(state.iterations());
+
+    PhaseCongruency whole(cv::Size(size, size), 4, 6, depth);
+    cv::Mat wholeEdges, wholeCorners, diff;
+    whole.feature(image, wholeEdges, wholeCorners);
+    const cv::Rect inner(2 * overlap, 2 * overlap, size - 4 * overlap, size - 4 * overlap);
+    cv::absdiff(edges(inner), wholeEdges(inner), diff);
+    double maxDiff = 0;
+    cv::minMaxLoc(diff, nullptr, &maxDiff);
+    state.counters["max_diff"] = maxDiff;
+    state.counters["mean_diff"] = cv::mean(diff)[0];
+}
+PC_BENCHMARK(BM_FeatureTiled)->ArgNames({ "size", "depth", "threads" })->ArgsProduct({ { 512, 1024 }, depths, { 1, 0 } });
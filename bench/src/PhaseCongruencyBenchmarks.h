@@ -0,0 +1,33 @@
+#pragma once
+
+#include "PhaseCongruency.h"
+#include <opencv2/imgproc.hpp>
+#include <cstdint>
+#include <vector>
+
+// Shared by the core and wrapper benchmarks. Sizes are square images;
+// depth is 64 for CV_64F, 32 for CV_32F; threads 0 uses OpenCV's pool;
+// backend is a PhaseCongruencyFFTBackend. Each translation unit gets its
+// own copy of the argument lists, so that they are initialized before its
+// benchmarks are registered.
+
+static const std::vector<int64_t> sizes = { 256, 512, 1024 };
+static const std::vector<int64_t> depths = { 64, 32 };
+
+inline int cvDepth(int64_t bits)
+{
+    return bits == 32 ? CV_32F : CV_64F;
+}
+
+// Deterministic test image: smoothed noise with a few bright shapes
+inline cv::Mat testImage(int size)
+{
+    cv::Mat image(size, size, CV_8UC1);
+    cv::RNG rng(12345);
+    rng.fill(image, cv::RNG::UNIFORM, 0, 256);
+    cv::GaussianBlur(image, image, cv::Size(0, 0), 2.0);
+    cv::rectangle(image, cv::Rect(size / 8, size / 8, size / 4, size / 4), cv::Scalar(230), cv::FILLED);
+    cv::circle(image, cv::Point(size * 2 / 3, size * 2 / 3), size / 6, cv::Scalar(30), cv::FILLED);
+    cv::line(image, cv::Point(0, size - 1), cv::Point(size - 1, 0), cv::Scalar(255), 2);
+    return image;
+}
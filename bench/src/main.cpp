@@ -0,0 +1,14 @@
+#include "ofMain.h"
+#include "Benchmark.h"
+
+//========================================================================
+// Runs the benchmarks and exits; no app loop. The hidden window only
+// provides the GL context for the texture upload in process.
+int main(int argc, char** argv){
+	ofGLFWWindowSettings settings;
+	settings.setSize(64, 64);
+	settings.visible = false;
+	ofCreateWindow(settings);
+
+	return bench::runBenchmarks(argc, argv);
+}
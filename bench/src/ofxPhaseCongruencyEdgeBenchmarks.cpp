@@ -0,0 +1,124 @@
+#include "Benchmark.h"
+#include "PhaseCongruencyBenchmarks.h"
+#include "ofxPhaseCongruencyEdge.h"
+#include "ofxCv.h"
+
+// End-to-end benchmarks of the openFrameworks wrapper. process uploads its
+// results to ofImage textures, so these need the GL context of the oF
+// bench app and are not part of the headless build.
+
+// toOf and texture upload of the two 8-bit results, as done by process
+static void BM_ToOfUpdate(bench::State& state)
+{
+    const int size = static_cast<int>(state.range(0));
+    const cv::Mat edges = testImage(size);
+    const cv::Mat corners = testImage(size);
+    ofImage edgeImage, cornerImage;
+
+    for (auto _ : state)
+    {
+        ofxCv::toOf(edges, edgeImage);
+        ofxCv::toOf(corners, cornerImage);
+        edgeImage.update();
+        cornerImage.update();
+    }
+}
+PC_BENCHMARK(BM_ToOfUpdate)->ArgNames({ "size" })->ArgsProduct({ sizes })->Unit("us");
+
+// The wrapper on a cv::Mat: feature plus toOf and texture upload; as in
+// BM_Feature, the workspace must not grow after the first frame
+static void BM_ProcessMat(bench::State& state)
+{
+    const int size = static_cast<int>(state.range(0));
+    ofxPhaseCongruencyEdge pc;
+    pc.setNumThreads(static_cast<int>(state.range(2)));
+    pc.setup(size, size, 4, 6, cvDepth(state.range(1)));
+    const cv::Mat image = testImage(size);
+    cv::Mat edges, corners;
+    pc.process(image, edges, corners);
+    const size_t allocations = pc.getWorkspaceAllocations();
+
+    for (auto _ : state)
+        pc.process(image, edges, corners);
+    state.SetItemsProcessed(state.iterations());
+    state.counters["allocations"] = static_cast<double>(pc.getWorkspaceAllocations() - allocations);
+    CV_Assert(pc.getWorkspaceAllocations() == allocations);
+}
+PC_BENCHMARK(BM_ProcessMat)->ArgNames({ "size", "depth", "threads" })->ArgsProduct({ sizes, depths, { 1, 0 } });
+
+// The wrapper in incremental mode on 256-pixel tiles: a static scene with
+// a small object moving across it (moving 1) or none. recomputed is the
+// mean fraction of the image recomputed per frame.
+static void BM_ProcessIncremental(bench::State& state)
+{
+    const int size = static_cast<int>(state.range(0));
+    ofxPhaseCongruencyEdge pc;
+    pc.setup(size, size, 4, 6, cvDepth(state.range(1)));
+    pc.setTileSize(256);
+    pc.setIncremental(true);
+    const cv::Mat scene = testImage(size);
+    cv::Mat frame = scene.clone();
+    cv::Mat edges, corners;
+    pc.process(frame, edges, corners);
+
+    double recomputed = 0;
+    int step = 0;
+    for (auto _ : state)
+    {
+        if (state.range(2) != 0)
+        {
+            scene.copyTo(frame);
+            const int x = (step++ * 8) % (size - 32);
+            cv::rectangle(frame, cv::Rect(x, size / 2, 32, 32), cv::Scalar(255), cv::FILLED);
+        }
+        pc.process(frame, edges, corners);
+        recomputed += pc.getRecomputedFraction();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["recomputed"] = state.iterations() > 0 ? recomputed / state.iterations() : 0;
+}
+PC_BENCHMARK(BM_ProcessIncremental)->ArgNames({ "size", "depth", "moving" })->ArgsProduct({ { 512, 1024 }, depths, { 0, 1 } });
+
+// The wrapper in ROI mode: rois 128x128 regions on a diagonal of the
+// image, each computed on its own window, into full-size outputs
+static void BM_ProcessRois(bench::State& state)
+{
+    const int size = static_cast<int>(state.range(0));
+    const int count = static_cast<int>(state.range(2));
+    ofxPhaseCongruencyEdge pc;
+    pc.setup(size, size, 4, 6, cvDepth(state.range(1)));
+    const cv::Mat image = testImage(size);
+    std::vector<cv::Rect> rois;
+    for (int i = 0; i < count; i++)
+        rois.push_back(cv::Rect((size - 128) * i / std::max(1, count - 1), (size - 128) * i / std::max(1, count - 1), 128, 128));
+    cv::Mat edges, corners;
+    pc.process(image, rois, edges, corners);
+
+    for (auto _ : state)
+        pc.process(image, rois, edges, corners);
+    state.SetItemsProcessed(state.iterations() * count);
+}
+PC_BENCHMARK(BM_ProcessRois)->ArgNames({ "size", "depth", "rois" })->ArgsProduct({ { 1024 }, depths, { 1, 4 } });
+
+// The wrapper on an RGB ofImage: toCv, grayscale conversion, feature,
+// toOf and texture upload of both the internal and the caller's images
+static void BM_ProcessImage(bench::State& state)
+{
+    const int size = static_cast<int>(state.range(0));
+    ofxPhaseCongruencyEdge pc;
+    pc.setNumThreads(static_cast<int>(state.range(2)));
+    pc.setup(size, size, 4, 6, cvDepth(state.range(1)));
+    cv::Mat rgb;
+    cv::cvtColor(testImage(size), rgb, cv::COLOR_GRAY2RGB);
+    ofImage input, edges, corners;
+    ofxCv::toOf(rgb, input);
+    pc.process(input, edges, corners);
+    const size_t allocations = pc.getWorkspaceAllocations();
+
+    for (auto _ : state)
+        pc.process(input, edges, corners);
+    state.SetItemsProcessed(state.iterations());
+    state.counters["allocations"] = static_cast<double>(pc.getWorkspaceAllocations() - allocations);
+    CV_Assert(pc.getWorkspaceAllocations() == allocations);
+}
+PC_BENCHMARK(BM_ProcessImage)->ArgNames({ "size", "depth", "threads" })->ArgsProduct({ sizes, depths, { 1, 0 } });
@@ -44,6 +44,55 @@ void ofApp::keyPressed(int key){
         cornerImage.save("pc_corners.png");
         ofLogNotice("ofApp") << "Saved edge and corner images";
     }
+    else if(key == 'a'){
+        reportPrecisionAccuracy();
+    }
+}
+
+//--------------------------------------------------------------
+void ofApp::reportPrecisionAccuracy(){
+    ofDirectory dir(ofToDataPath(""));
+    dir.allowExt("jpg");
+    dir.allowExt("jpeg");
+    dir.allowExt("png");
+    dir.listDir();
+    
+    for(size_t i = 0; i < dir.size(); i++){
+        ofImage image;
+        if(!image.load(dir.getPath(i))){
+            continue;
+        }
+        cv::Mat gray = ofxCv::toCv(image);
+        if(gray.channels() > 1){
+            cv::cvtColor(gray, gray, gray.channels() == 4 ? cv::COLOR_RGBA2GRAY : cv::COLOR_RGB2GRAY);
+        }
+        
+        ofxPhaseCongruencyEdge pc64, pc32;
+        pc64.setup(gray.cols, gray.rows, 4, 6, CV_64F);
+        pc32.setup(gray.cols, gray.rows, 4, 6, CV_32F);
+        
+        cv::Mat edges64, corners64, edges32, corners32;
+        uint64_t t0 = ofGetElapsedTimeMillis();
+        pc64.process(gray, edges64, corners64);
+        uint64_t t1 = ofGetElapsedTimeMillis();
+        pc32.process(gray, edges32, corners32);
+        uint64_t t2 = ofGetElapsedTimeMillis();
+        
+        cv::Mat edgeDiff, cornerDiff;
+        cv::absdiff(edges64, edges32, edgeDiff);
+        cv::absdiff(corners64, corners32, cornerDiff);
+        double edgeMax, cornerMax;
+        cv::minMaxLoc(edgeDiff, nullptr, &edgeMax);
+        cv::minMaxLoc(cornerDiff, nullptr, &cornerMax);
+        const double total = static_cast<double>(edgeDiff.total());
+        
+        ofLogNotice("ofApp") << dir.getName(i) << " " << gray.cols << "x" << gray.rows
+            << " | edges: max " << edgeMax << ", mean " << cv::mean(edgeDiff)[0]
+            << ", >1 level " << 100.0 * cv::countNonZero(edgeDiff > 1) / total << "%"
+            << " | corners: max " << cornerMax << ", mean " << cv::mean(cornerDiff)[0]
+            << ", >1 level " << 100.0 * cv::countNonZero(cornerDiff > 1) / total << "%"
+            << " | 64F " << (t1 - t0) << " ms, 32F " << (t2 - t1) << " ms";
+    }
 }
 
 //--------------------------------------------------------------
@@ -21,6 +21,9 @@ class ofApp : public ofBaseApp{
 		void dragEvent(ofDragInfo dragInfo);
 		void gotMessage(ofMessage msg);
 		
+		// Compare the CV_32F pipeline against CV_64F on every image in data/
+		void reportPrecisionAccuracy();
+		
 		ofxPhaseCongruencyEdge pc;
 		ofImage inputImage;
 		ofImage edgeImage;
@@ -0,0 +1,2106 @@
+#include "PhaseCongruency.h"
+#include "PhaseCongruencyKernels.h"
+#include <opencv2/imgproc.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace cv;
+using namespace pcdetail;
+
+// Split a real, DC-at-origin transfer function h into the CCS-packed
+// spectra of its even part He(k) = (h(k) + h(-k)) / 2 and of -i * Ho(k),
+// Ho(k) = (h(k) - h(-k)) / 2. Both are Hermitian, so mulSpectrums keeps
+// the packed layout and DFT_REAL_OUTPUT gives the real and imaginary
+// parts of the complex filter response.
+static void packFilterCCS(const Mat& h, Mat& even, Mat& odd)
+{
+    const int M = h.rows;
+    const int N = h.cols;
+
+    even = Mat::zeros(M, N, h.type());
+    odd = Mat::zeros(M, N, h.type());
+
+    auto evenAt = [&](int k, int j) {
+        return 0.5 * (h.at<double>(k, j) + h.at<double>((M - k) % M, (N - j) % N));
+    };
+    auto oddAt = [&](int k, int j) {
+        return 0.5 * (h.at<double>(k, j) - h.at<double>((M - k) % M, (N - j) % N));
+    };
+
+    // Complex columns: (Re, Im) pairs at columns (2j-1, 2j) for every row
+    for (int j = 1; 2 * j < N; j++)
+    {
+        for (int k = 0; k < M; k++)
+        {
+            even.at<double>(k, 2 * j - 1) = evenAt(k, j);
+            odd.at<double>(k, 2 * j) = -oddAt(k, j);
+        }
+    }
+
+    // Real columns (frequency 0 and, for even widths, N/2) are packed
+    // once more along the rows
+    auto packColumn = [&](int dst_col, int freq_col) {
+        even.at<double>(0, dst_col) = evenAt(0, freq_col);
+        for (int i = 1; 2 * i < M; i++)
+        {
+            even.at<double>(2 * i - 1, dst_col) = evenAt(i, freq_col);
+            odd.at<double>(2 * i, dst_col) = -oddAt(i, freq_col);
+        }
+        if (M % 2 == 0)
+            even.at<double>(M - 1, dst_col) = evenAt(M / 2, freq_col);
+    };
+    packColumn(0, 0);
+    if (N % 2 == 0)
+        packColumn(N - 1, N / 2);
+}
+
+// Copy every real slot of a CCS-packed spectrum into its imaginary slot
+// (or, with fromImag, every imaginary slot into its real slot), so that an
+// element-wise product with a packed spectrum scales both parts of each
+// complex value by the same factor
+static void spreadCCS(Mat& packed, bool fromImag = false)
+{
+    const int M = packed.rows;
+    const int N = packed.cols;
+    const int src = fromImag ? 0 : -1;
+    const int dst = fromImag ? -1 : 0;
+
+    for (int k = 0; k < M; k++)
+    {
+        auto row = packed.ptr<double>(k);
+        for (int j = 1; 2 * j < N; j++)
+            row[2 * j + dst] = row[2 * j + src];
+    }
+    for (int col : { 0, N - 1 })
+    {
+        if (col == N - 1 && N % 2 != 0)
+            break;
+        for (int i = 1; 2 * i < M; i++)
+            packed.at<double>(2 * i + dst, col) = packed.at<double>(2 * i + src, col);
+    }
+}
+
+// The filter bank is always designed in double precision and converted
+// to the working depth once it is packed
+#define MAT_TYPE CV_64FC1
+
+// Signed frequency of DFT index u in a transform of length n, with DC at
+// u = 0: 0, 1, ..., (n - 1) / 2, then the negative frequencies. For even n
+// the n/2 bin is taken as -n/2.
+static inline int dftFrequency(int u, int n)
+{
+    return u < (n + 1) / 2 ? u : u - n;
+}
+
+// Radial log-Gabor components of every scale, generated directly in the
+// DC-at-origin layout, CCS-packed and spread over both slots of each
+// complex value
+static std::vector<Mat> buildRadial(int dft_M, int dft_N, int nscale, double sigma, double minwavelength, double mult)
+{
+    Mat gabor(dft_M, dft_N, MAT_TYPE);
+    Mat unused;
+    std::vector<Mat> radial(nscale);
+
+    // Radius normalised by r, the half size of the smaller dimension; the
+    // filters are zero outside the centred (2r+1)^2 frequency square
+    const int r = std::min(dft_M / 2, dft_N / 2);
+    const double dr = 1.0 / static_cast<double>(r);
+
+    // The following implements the log-gabor transfer function.
+    double mt = 1.0f;
+    for (int scale = 0; scale < nscale; scale++)
+    {
+        const double wavelength = minwavelength * mt;
+        for (int row = 0; row < dft_M; row++)
+        {
+            const int m = dftFrequency(row, dft_M);
+            auto gabor_row = gabor.ptr<double>(row);
+            for (int col = 0; col < dft_N; col++)
+            {
+                const int n = dftFrequency(col, dft_N);
+                if ((m == 0 && n == 0) || std::abs(m) > r || std::abs(n) > r)
+                {
+                    gabor_row[col] = 0.0;
+                    continue;
+                }
+                const double radius = sqrt(static_cast<double>(m * m + n * n)) * dr;
+                const double lg = log(radius * wavelength);
+                const double lp = pow(radius * 2.5, 20.0) + 1.0; // low-pass
+                gabor_row[col] = exp(sigma * lg * lg) / lp;
+            }
+        }
+        mt = mt * mult;
+
+        packFilterCCS(gabor, radial[scale], unused);
+        spreadCCS(radial[scale]);
+    }
+    return radial;
+}
+
+// Angular components that control the orientation selectivity, split and
+// packed like the filters themselves. They depend only on the DFT size and
+// norient, so they are shared by every set of radial parameters.
+struct pcdetail::AngularBank
+{
+    std::vector<cv::Mat> even;
+    std::vector<cv::Mat> odd;
+};
+
+static std::shared_ptr<AngularBank> buildAngular(int dft_M, int dft_N, int norient)
+{
+    auto bank = std::make_shared<AngularBank>();
+    bank->even.resize(norient);
+    bank->odd.resize(norient);
+
+    // Polar angle of every frequency sample, DC at the origin
+    Mat theta(dft_M, dft_N, MAT_TYPE);
+    for (int i = 0; i < dft_M; i++)
+    {
+        auto theta_row = theta.ptr<double>(i);
+        const double fm = static_cast<double>(dftFrequency(i, dft_M)) / dft_M;
+        for (int j = 0; j < dft_N; j++)
+            theta_row[j] = atan2(-static_cast<double>(dftFrequency(j, dft_N)) / dft_N, fm);
+    }
+
+    Mat angular(dft_M, dft_N, MAT_TYPE);
+    const double angle_const = CV_PI / static_cast<double>(norient);
+    for (int ori = 0; ori < norient; ori++)
+    {
+        double angl = (double)ori * angle_const;
+        //Now we calculate the angular component that controls the orientation selectivity of the filter.
+        for (int i = 0; i < dft_M; i++)
+        {
+            auto theta_row = theta.ptr<double>(i);
+            auto angular_row = angular.ptr<double>(i);
+            for (int j = 0; j < dft_N; j++)
+            {
+                double s = sin(theta_row[j]);
+                double c = cos(theta_row[j]);
+                double m = s * cos(angl) - c * sin(angl);
+                double n = c * cos(angl) + s * sin(angl);
+                s = fabs(atan2(m, n));
+
+                angular_row[j] = (cos(min(s * (double)norient * 0.5, CV_PI)) + 1.0) * 0.5;
+            }
+        }
+        packFilterCCS(angular, bank->even[ori], bank->odd[ori]);
+    }//orientation
+    return bank;
+}
+
+// Making a filter: since the radial part is symmetric, the packed even/odd
+// filters are the packed angular parts scaled by the spread radial part
+static std::shared_ptr<FilterBank> buildFilterBank(const FilterBankKey& key, const AngularBank& angular)
+{
+    auto bank = std::make_shared<FilterBank>();
+    bank->key = key;
+
+    const int nscale = key.nscale;
+    const int norient = key.norient;
+    const std::vector<Mat> radial = buildRadial(key.rows, key.cols, nscale, key.sigma, key.minwavelength, key.mult);
+
+    if (key.compact)
+    {
+        bank->radial.resize(nscale);
+        bank->angularEven.resize(norient);
+        bank->angularOdd.resize(norient);
+        for (int scale = 0; scale < nscale; scale++)
+            radial[scale].convertTo(bank->radial[scale], key.depth);
+        for (int ori = 0; ori < norient; ori++)
+        {
+            Mat spread = angular.even[ori].clone();
+            spreadCCS(spread);
+            spread.convertTo(bank->angularEven[ori], key.depth);
+            spread = angular.odd[ori].clone();
+            spreadCCS(spread, true);
+            spread.convertTo(bank->angularOdd[ori], key.depth);
+        }
+        return bank;
+    }
+
+    bank->even.resize(nscale * norient);
+    bank->odd.resize(nscale * norient);
+    for (int ori = 0; ori < norient; ori++)
+    {
+        for (int scale = 0; scale < nscale; scale++)
+        {
+            //Product of the two components.
+            multiply(radial[scale], angular.even[ori], bank->even[nscale * ori + scale], 1.0, key.depth);
+            multiply(radial[scale], angular.odd[ori], bank->odd[nscale * ori + scale], 1.0, key.depth);
+        }//scale
+    }//orientation
+    //Filter ready
+    return bank;
+}
+
+// On-disk filter banks: a 64-byte header followed by the planes in the
+// order of planeGroups, each plane stored continuously, 64-byte aligned.
+static const char filterFileMagic[8] = { 'P', 'C', 'F', 'B', 'A', 'N', 'K', '1' };
+static const size_t filterFileHeaderSize = 64;
+
+struct FilterFileHeader
+{
+    char magic[8];
+    int32_t rows, cols, nscale, norient, depth, compact;
+    double sigma, minwavelength, mult;
+};
+
+// Plane vectors of a bank in file order, sized for its key
+static std::vector<std::vector<Mat>*> planeGroups(FilterBank& bank)
+{
+    const FilterBankKey& key = bank.key;
+    if (key.compact)
+    {
+        bank.radial.resize(key.nscale);
+        bank.angularEven.resize(key.norient);
+        bank.angularOdd.resize(key.norient);
+        return { &bank.radial, &bank.angularEven, &bank.angularOdd };
+    }
+    bank.even.resize(static_cast<size_t>(key.nscale) * key.norient);
+    bank.odd.resize(static_cast<size_t>(key.nscale) * key.norient);
+    return { &bank.even, &bank.odd };
+}
+
+static size_t planeCount(const FilterBankKey& key)
+{
+    return key.compact ? key.nscale + 2 * static_cast<size_t>(key.norient)
+                       : 2 * static_cast<size_t>(key.nscale) * key.norient;
+}
+
+static size_t alignedPlaneBytes(const FilterBankKey& key)
+{
+    const size_t bytes = static_cast<size_t>(key.rows) * key.cols * CV_ELEM_SIZE(key.depth);
+    return (bytes + 63) & ~static_cast<size_t>(63);
+}
+
+static std::string filterFilePath(const std::string& dir, const FilterBankKey& key)
+{
+    // Doubles are encoded by their bit patterns so that the name is exact
+    auto bits = [](double v) {
+        uint64_t u;
+        memcpy(&u, &v, sizeof(u));
+        return u;
+    };
+    char name[160];
+    snprintf(name, sizeof(name), "pcbank_%dx%d_s%d_o%d_d%d%s_%016llx_%016llx_%016llx.bin",
+             key.cols, key.rows, key.nscale, key.norient, key.depth, key.compact ? "c" : "",
+             (unsigned long long)bits(key.sigma), (unsigned long long)bits(key.minwavelength),
+             (unsigned long long)bits(key.mult));
+    return dir + "/" + name;
+}
+
+static bool headerMatches(const FilterFileHeader& header, const FilterBankKey& key)
+{
+    return memcmp(header.magic, filterFileMagic, sizeof(filterFileMagic)) == 0 &&
+        header.rows == key.rows && header.cols == key.cols &&
+        header.nscale == key.nscale && header.norient == key.norient && header.depth == key.depth &&
+        header.compact == static_cast<int32_t>(key.compact) &&
+        header.sigma == key.sigma && header.minwavelength == key.minwavelength && header.mult == key.mult;
+}
+
+// Wrap the bank's planes around a loaded file image
+static void attachPlanes(FilterBank& bank, uchar* data)
+{
+    const FilterBankKey& key = bank.key;
+    uchar* plane = data + filterFileHeaderSize;
+    for (std::vector<Mat>* planes : planeGroups(bank))
+    {
+        for (Mat& m : *planes)
+        {
+            m = Mat(key.rows, key.cols, CV_MAKETYPE(key.depth, 1), plane);
+            plane += alignedPlaneBytes(key);
+        }
+    }
+}
+
+static std::shared_ptr<FilterBank> loadFilterBank(const std::string& path, const FilterBankKey& key)
+{
+    const size_t fileSize = filterFileHeaderSize + planeCount(key) * alignedPlaneBytes(key);
+    auto bank = std::make_shared<FilterBank>();
+    bank->key = key;
+
+#ifdef _WIN32
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return nullptr;
+    bank->storage = std::shared_ptr<void>(fastMalloc(fileSize), fastFree);
+    if (!file.read(static_cast<char*>(bank->storage.get()), static_cast<std::streamsize>(fileSize)))
+        return nullptr;
+#else
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) != fileSize)
+    {
+        close(fd);
+        return nullptr;
+    }
+    void* mapped = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+        return nullptr;
+    bank->storage = std::shared_ptr<void>(mapped, [fileSize](void* p) { munmap(p, fileSize); });
+#endif
+
+    uchar* data = static_cast<uchar*>(bank->storage.get());
+    FilterFileHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (!headerMatches(header, key))
+        return nullptr;
+
+    attachPlanes(*bank, data);
+    return bank;
+}
+
+static void saveFilterBank(const std::string& path, FilterBank& bank)
+{
+    const FilterBankKey& key = bank.key;
+    FilterFileHeader header = {};
+    memcpy(header.magic, filterFileMagic, sizeof(filterFileMagic));
+    header.rows = key.rows;
+    header.cols = key.cols;
+    header.nscale = key.nscale;
+    header.norient = key.norient;
+    header.depth = key.depth;
+    header.compact = key.compact;
+    header.sigma = key.sigma;
+    header.minwavelength = key.minwavelength;
+    header.mult = key.mult;
+
+    // Write to a name unique to this process and thread, then rename, so
+    // that concurrent readers never map a partially written bank and
+    // concurrent writers of the same bank never share a file
+#ifdef _WIN32
+    const long pid = static_cast<long>(_getpid());
+#else
+    const long pid = static_cast<long>(getpid());
+#endif
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), ".%ld.%zx.tmp", pid, std::hash<std::thread::id>()(std::this_thread::get_id()));
+    const std::string tmpPath = path + suffix;
+    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return;
+
+    std::vector<char> block(filterFileHeaderSize, 0);
+    memcpy(block.data(), &header, sizeof(header));
+    file.write(block.data(), block.size());
+
+    block.assign(alignedPlaneBytes(key), 0);
+    for (const std::vector<Mat>* planes : planeGroups(bank))
+    {
+        for (const Mat& plane : *planes)
+        {
+            const size_t rowBytes = plane.cols * plane.elemSize();
+            for (int row = 0; row < plane.rows; row++)
+                memcpy(block.data() + row * rowBytes, plane.ptr(row), rowBytes);
+            file.write(block.data(), block.size());
+        }
+    }
+    file.close();
+    if (!file || std::rename(tmpPath.c_str(), path.c_str()) != 0)
+        std::remove(tmpPath.c_str());
+}
+
+// Process-wide cache of filter banks shared by every PhaseCongruency, and
+// of the angular masks they are built from, keyed by (rows, cols, norient).
+// Entries are weak: a bank lives as long as an instance uses it, plus the
+// last few acquired banks and masks, so setup for a size that was just
+// released stays cheap while retired sizes do not pin memory forever.
+static const size_t filterCacheRecent = 4;
+static std::mutex filterCacheMutex;
+static std::map<FilterBankKey, std::weak_ptr<const FilterBank> > filterCache;
+static std::map<FilterBankKey, std::shared_future<std::shared_ptr<const FilterBank> > > filterBuilds;
+static std::map<std::tuple<int, int, int>, std::weak_ptr<const AngularBank> > angularCache;
+static std::list<std::shared_ptr<const void> > recentBanks;
+static std::string filterCacheDirectory;
+
+// Called with filterCacheMutex held
+template<typename Map>
+static void pruneExpired(Map& cache)
+{
+    for (auto entry = cache.begin(); entry != cache.end();)
+        entry = entry->second.expired() ? cache.erase(entry) : std::next(entry);
+}
+
+// Called with filterCacheMutex held
+static void keepRecent(const std::shared_ptr<const void>& entry)
+{
+    recentBanks.remove(entry);
+    recentBanks.push_front(entry);
+    if (recentBanks.size() > filterCacheRecent)
+        recentBanks.pop_back();
+    pruneExpired(filterCache);
+    pruneExpired(angularCache);
+}
+
+// Angular masks are built outside the lock; two threads that miss on the
+// same size at once both build them and the first one stored wins.
+static std::shared_ptr<const AngularBank> acquireAngularBank(int rows, int cols, int norient)
+{
+    const auto key = std::make_tuple(rows, cols, norient);
+    {
+        std::lock_guard<std::mutex> lock(filterCacheMutex);
+        auto cached = angularCache.find(key);
+        if (cached != angularCache.end())
+        {
+            if (auto angular = cached->second.lock())
+            {
+                keepRecent(angular);
+                return angular;
+            }
+        }
+    }
+
+    std::shared_ptr<const AngularBank> angular = buildAngular(rows, cols, norient);
+
+    std::lock_guard<std::mutex> lock(filterCacheMutex);
+    auto& cached = angularCache[key];
+    if (auto existing = cached.lock())
+        angular = existing;
+    else
+        cached = angular;
+    keepRecent(angular);
+    return angular;
+}
+
+// A bank already in use or recently used, without building or loading one
+static std::shared_ptr<const FilterBank> findFilterBank(const FilterBankKey& key)
+{
+    std::lock_guard<std::mutex> lock(filterCacheMutex);
+    auto cached = filterCache.find(key);
+    return cached != filterCache.end() ? cached->second.lock() : nullptr;
+}
+
+static std::shared_ptr<const FilterBank> loadOrBuildFilterBank(const FilterBankKey& key, const std::string& dir)
+{
+    std::shared_ptr<FilterBank> bank;
+    if (!dir.empty())
+        bank = loadFilterBank(filterFilePath(dir, key), key);
+    if (!bank)
+    {
+        bank = buildFilterBank(key, *acquireAngularBank(key.rows, key.cols, key.norient));
+        if (!dir.empty())
+            saveFilterBank(filterFilePath(dir, key), *bank);
+    }
+    return bank;
+}
+
+// The bank is loaded or built without holding filterCacheMutex, so other
+// keys are served meanwhile; concurrent requests for the same key wait on
+// the one build in flight instead of starting their own.
+std::shared_ptr<const FilterBank> PhaseCongruency::acquireFilterBank(const FilterBankKey& key)
+{
+    std::promise<std::shared_ptr<const FilterBank> > built;
+    std::string dir;
+    {
+        std::unique_lock<std::mutex> lock(filterCacheMutex);
+
+        auto cached = filterCache.find(key);
+        if (cached != filterCache.end())
+        {
+            if (auto bank = cached->second.lock())
+            {
+                keepRecent(bank);
+                return bank;
+            }
+        }
+
+        auto pending = filterBuilds.find(key);
+        if (pending != filterBuilds.end())
+        {
+            auto build = pending->second;
+            lock.unlock();
+            return build.get();
+        }
+
+        filterBuilds[key] = built.get_future().share();
+        dir = filterCacheDirectory;
+    }
+
+    std::shared_ptr<const FilterBank> bank;
+    try
+    {
+        bank = loadOrBuildFilterBank(key, dir);
+    }
+    catch (...)
+    {
+        {
+            std::lock_guard<std::mutex> lock(filterCacheMutex);
+            filterBuilds.erase(key);
+        }
+        built.set_exception(std::current_exception());
+        throw;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(filterCacheMutex);
+        filterCache[key] = bank;
+        filterBuilds.erase(key);
+        keepRecent(bank);
+    }
+    built.set_value(bank);
+    return bank;
+}
+
+// mkdir -p; true if dir is a directory afterwards
+static bool createDirectories(const std::string& dir)
+{
+    for (size_t end = dir.find_first_of("/\\", 1); ; end = dir.find_first_of("/\\", end + 1))
+    {
+        const std::string prefix = dir.substr(0, end);
+#ifdef _WIN32
+        _mkdir(prefix.c_str());
+#else
+        mkdir(prefix.c_str(), 0777);
+#endif
+        if (end == std::string::npos)
+            break;
+    }
+#ifdef _WIN32
+    struct _stat st;
+    return _stat(dir.c_str(), &st) == 0 && (st.st_mode & _S_IFDIR) != 0;
+#else
+    struct stat st;
+    return stat(dir.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+#endif
+}
+
+bool PhaseCongruency::setFilterCacheDirectory(const std::string& dir)
+{
+    const bool usable = dir.empty() || createDirectories(dir);
+    const std::string cacheDir = usable ? dir : std::string();
+    PhaseCongruencyFFT::setWisdomDirectory(cacheDir);
+    std::lock_guard<std::mutex> lock(filterCacheMutex);
+    filterCacheDirectory = cacheDir;
+    return usable;
+}
+
+void PhaseCongruency::clearFilterCache()
+{
+    std::lock_guard<std::mutex> lock(filterCacheMutex);
+    filterCache.clear();
+    angularCache.clear();
+    recentBanks.clear();
+}
+
+PhaseCongruency::PhaseCongruency(cv::Size _size, size_t _nscale, size_t _norient, int _depth,
+                                 const PhaseCongruencyConst& _pcc, bool _compact)
+{
+    CV_Assert(_depth == CV_64F || _depth == CV_32F);
+
+    size = _size;
+    nscale = _nscale;
+    norient = _norient;
+    depth = _depth;
+    compact = _compact;
+    pcc = _pcc;
+
+    bank = acquireFilterBank(filterBankKey());
+    prepareWorkspace();
+
+#ifdef PHASECONGRUENCY_PROFILE
+    stageProfiler = std::make_shared<PhaseCongruencyProfiler>();
+#endif
+}
+
+PhaseCongruency::PhaseCongruency(const PhaseCongruency* owner)
+{
+    size = owner->size;
+    nscale = owner->nscale;
+    norient = owner->norient;
+    depth = owner->depth;
+    compact = owner->compact;
+}
+
+FilterBankKey PhaseCongruency::filterBankKey() const
+{
+    FilterBankKey key;
+    key.rows = getOptimalDFTSize(size.height);
+    key.cols = getOptimalDFTSize(size.width);
+    key.nscale = static_cast<int>(nscale);
+    key.norient = static_cast<int>(norient);
+    key.depth = depth;
+    key.sigma = pcc.sigma;
+    key.minwavelength = pcc.minwavelength;
+    key.mult = pcc.mult;
+    key.compact = compact;
+    return key;
+}
+
+// Only sigma, minwavelength and mult shape the filters. A change in any of
+// them rebuilds this instance's bank from its angular masks, unless a bank
+// for the new parameters is already in use. Live tuning goes through here
+// once per value, so these banks are neither cached nor written to the
+// cache directory. k, g, cutOff and epsilon are used per frame only.
+void PhaseCongruency::setConst(PhaseCongruencyConst _pcc)
+{
+    const bool radialChanged = _pcc.sigma != pcc.sigma ||
+        _pcc.minwavelength != pcc.minwavelength || _pcc.mult != pcc.mult;
+    if (radialChanged || _pcc.k != pcc.k || _pcc.g != pcc.g ||
+        _pcc.cutOff != pcc.cutOff || _pcc.epsilon != pcc.epsilon)
+        resetIncremental();
+
+    pcc = _pcc;
+
+    if (radialChanged)
+    {
+        const FilterBankKey key = filterBankKey();
+        bank = findFilterBank(key);
+        if (!bank)
+        {
+            if (!angular)
+                angular = acquireAngularBank(key.rows, key.cols, key.norient);
+            bank = buildFilterBank(key, *angular);
+        }
+        prepareWorkspace();
+    }
+}
+
+void PhaseCongruency::setCompactFilters(bool _compact)
+{
+    if (_compact == compact)
+        return;
+
+    compact = _compact;
+    bank = acquireFilterBank(filterBankKey());
+    prepareWorkspace();
+    resetIncremental();
+}
+
+void PhaseCongruency::setPyramid(bool _pyramid)
+{
+    if (_pyramid != pyramid)
+        resetIncremental();
+    pyramid = _pyramid;
+    prepareWorkspace();
+}
+
+void PhaseCongruency::setFFTBackend(PhaseCongruencyFFTBackend _backend)
+{
+    CV_Assert(PhaseCongruencyFFT::available(_backend));
+    if (_backend != fftBackend)
+        resetIncremental();
+    fftBackend = _backend;
+    prepareWorkspace();
+}
+
+void PhaseCongruency::setNumThreads(int _nthreads)
+{
+    nthreads = _nthreads;
+    prepareWorkspace();
+}
+
+int PhaseCongruency::workerCount() const
+{
+    return nthreads > 0 ? nthreads : std::max(1, getNumThreads());
+}
+
+// CCS spectrum times a compact filter, radial[scale] * angular[ori]. The
+// factors are spread over both slots of each complex value, so the even
+// product is element-wise; the odd filter -i * Ho maps (re, im) to
+// (-im * h, re * h) and vanishes on the purely real DC/Nyquist slots.
+template<typename T>
+static void compactSpectrumProduct(const Mat& spectrum, const Mat& radial, const Mat& angular, bool odd, Mat& dst)
+{
+    const int M = spectrum.rows;
+    const int N = spectrum.cols;
+    dst.create(M, N, spectrum.type());
+
+    // last interior column + 1; the N/2 frequency is packed in column N - 1
+    const int last = (N % 2 == 0) ? N - 1 : N;
+    for (int k = 0; k < M; k++)
+    {
+        const T* f = spectrum.ptr<T>(k);
+        const T* r = radial.ptr<T>(k);
+        const T* a = angular.ptr<T>(k);
+        T* d = dst.ptr<T>(k);
+
+        if (!odd)
+        {
+            for (int j = 0; j < N; j++)
+                d[j] = f[j] * r[j] * a[j];
+            continue;
+        }
+        for (int c = 1; c + 1 < last; c += 2)
+        {
+            const T h = r[c] * a[c];
+            const T re = f[c];
+            d[c] = -f[c + 1] * h;
+            d[c + 1] = re * h;
+        }
+    }
+    if (!odd)
+        return;
+
+    for (int col : { 0, N - 1 })
+    {
+        if (col == N - 1 && N % 2 != 0)
+            break;
+        dst.at<T>(0, col) = 0;
+        for (int i = 1; 2 * i < M; i++)
+        {
+            const T h = radial.at<T>(2 * i - 1, col) * angular.at<T>(2 * i - 1, col);
+            const T re = spectrum.at<T>(2 * i - 1, col);
+            dst.at<T>(2 * i - 1, col) = -spectrum.at<T>(2 * i, col) * h;
+            dst.at<T>(2 * i, col) = re * h;
+        }
+        if (M % 2 == 0)
+            dst.at<T>(M - 1, col) = 0;
+    }
+}
+
+// Pyramid mode: a scale is inverted at level k, on a spectrum cropped to
+// about 1/2^k of each dimension, when its filter (log-Gabor times the
+// low-pass) stays below pyramidTolerance of its peak beyond pyramidGuard
+// of the crop's Nyquist radius. The guard band keeps the response
+// oversampled enough for cubic upsampling (about 2% RMS error per
+// decimated response, measured on 512x512 with the default parameters).
+static const double pyramidTolerance = 0.01;
+static const double pyramidGuard = 0.8;
+
+// Smallest fast DFT size >= n that is even, so that the crop has a plain
+// CCS layout with a Nyquist row and column
+static int evenDFTSize(int n)
+{
+    int size = getOptimalDFTSize(n);
+    while (size % 2 != 0)
+        size = getOptimalDFTSize(size + 1);
+    return size;
+}
+
+// Largest radial filter value at normalised radius >= radius
+static double radialTail(double radius, double wavelength, double sigma)
+{
+    double tail = 0;
+    for (int i = 0; i <= 64; i++)
+    {
+        const double rr = radius + (sqrt(2.0) - radius) * i / 64.0;
+        const double lg = log(rr * wavelength);
+        tail = std::max(tail, exp(sigma * lg * lg) / (pow(rr * 2.5, 20.0) + 1.0));
+    }
+    return tail;
+}
+
+// Low-frequency rows x cols part of a CCS spectrum. The unscaled inverse
+// of the crop samples the same band-limited signal on a coarser grid, so no
+// rescaling is needed. The crop's Nyquist row and column are set to zero:
+// the filters are negligible there and the crop's own Hermitian symmetry
+// would not hold for them anyway.
+template<typename T>
+static void cropSpectrum(const Mat& src, Mat& dst)
+{
+    const int M = src.rows;
+    const int rows = dst.rows;
+    const int cols = dst.cols;
+
+    for (int u = 0; u < rows; u++)
+    {
+        T* d = dst.ptr<T>(u);
+
+        // The DC column is packed down the rows identically in both
+        d[0] = u < rows - 1 ? src.ptr<T>(u)[0] : T(0);
+
+        if (u == rows / 2)
+        {
+            std::fill(d + 1, d + cols, T(0));
+            continue;
+        }
+        const T* r = src.ptr<T>(u < rows / 2 ? u : u - rows + M);
+        std::copy(r + 1, r + cols - 1, d + 1);
+        d[cols - 1] = T(0);
+    }
+}
+
+// Spectrum times the even (part 0) or odd (part 1) filter of index. dst
+// may be a view of the right shape; it is written in place.
+void PhaseCongruency::spectrumProduct(const Mat& dft_A, size_t index, int part, Mat& dst) const
+{
+    if (!bank->key.compact)
+    {
+        mulSpectrums(dft_A, part == 0 ? bank->even[index] : bank->odd[index], dst, 0); // Convolution
+        return;
+    }
+    const Mat& radial = bank->radial[index % nscale];
+    const Mat& angular = part == 0 ? bank->angularEven[index / nscale] : bank->angularOdd[index / nscale];
+    if (depth == CV_32F)
+        compactSpectrumProduct<float>(dft_A, radial, angular, part == 1, dst);
+    else
+        compactSpectrumProduct<double>(dft_A, radial, angular, part == 1, dst);
+}
+
+// Pyramid mode: the same product for a scale decimated to level, formed
+// from the spectrum and filters cropped to that level. Cropping commutes
+// with the element-wise product, so only the cropped band is multiplied.
+void PhaseCongruency::levelProduct(size_t index, int part, int level, Mat& dst) const
+{
+    const Mat& spectrum = ws.levelSpectrum[level];
+    if (!bank->key.compact)
+    {
+        mulSpectrums(spectrum, part == 0 ? ws.levelEven[index] : ws.levelOdd[index], dst, 0);
+        return;
+    }
+    const Mat& radial = ws.levelRadial[index % nscale];
+    const size_t a = norient * level + index / nscale;
+    const Mat& angular = part == 0 ? ws.levelAngularEven[a] : ws.levelAngularOdd[a];
+    if (depth == CV_32F)
+        compactSpectrumProduct<float>(spectrum, radial, angular, part == 1, dst);
+    else
+        compactSpectrumProduct<double>(spectrum, radial, angular, part == 1, dst);
+}
+
+// Even/odd response of one filter of the bank over the padded frame. In
+// pyramid mode, scales at level k > 0 are inverted on the product at the
+// crop size and cubic-upsampled into the image region of the response.
+void PhaseCongruency::filterResponse(const Mat& dft_A, size_t index, WorkerScratch& scratch,
+                                     Mat& responseRe, Mat& responseIm) const
+{
+    Mat filtered = scratch.products.rowRange(0, dft_A.rows);
+    const int level = ws.scaleLevel[index % nscale];
+
+    for (int part = 0; part < 2; part++)
+    {
+        Mat& response = part == 0 ? responseRe : responseIm;
+        if (level == 0)
+        {
+            spectrumProduct(dft_A, index, part, filtered);
+            ws.fft[0]->inverse(filtered, response, scratch.fftScratch);
+            continue;
+        }
+
+        Mat& product = scratch.levelProduct[level];
+        Mat& small = scratch.levelResponse[level];
+        levelProduct(index, part, level, product);
+        ws.fft[level]->inverse(product, small, scratch.fftScratch);
+
+        // Sample x of the crop lies at x * cols / crop cols of the frame
+        const cv::Matx23d toSmall(static_cast<double>(product.cols) / dft_A.cols, 0, 0,
+                                  0, static_cast<double>(product.rows) / dft_A.rows, 0);
+        Mat image = response(cv::Rect(0, 0, size.width, size.height));
+        warpAffine(small, image, toSmall, size, INTER_CUBIC | WARP_INVERSE_MAP, BORDER_WRAP);
+    }
+}
+
+// Responses of jobs [first, last) of the group starting at orientation o0.
+// Consecutive full-resolution jobs are multiplied into the worker's
+// stacked products and inverted together, ws.batchJobs at a time, straight
+// into their planes of ws.responses. Pyramid scales go one by one.
+void PhaseCongruency::filterJobs(const Mat& dft_A, size_t o0, int first, int last, WorkerScratch& scratch)
+{
+    const int M = dft_A.rows;
+    int batchStart = first;
+    auto flush = [&](int end) {
+        const int planes = 2 * (end - batchStart);
+        if (planes > 0)
+        {
+            Mat responses = ws.responses.rowRange(2 * batchStart * M, 2 * end * M);
+            ws.fft[0]->inverseMany(scratch.products.rowRange(0, planes * M), responses, planes, scratch.fftScratch);
+        }
+        batchStart = end;
+    };
+
+    for (int job = first; job < last; job++)
+    {
+        const size_t index = nscale * o0 + job;
+        if (ws.scaleLevel[index % nscale] > 0)
+        {
+            flush(job);
+            filterResponse(dft_A, index, scratch, ws.responseRe[job], ws.responseIm[job]);
+            batchStart = job + 1;
+            continue;
+        }
+
+        const int plane = 2 * (job - batchStart);
+        for (int part = 0; part < 2; part++)
+        {
+            Mat product = scratch.products.rowRange((plane + part) * M, (plane + part + 1) * M);
+            spectrumProduct(dft_A, index, part, product);
+        }
+        if (job + 1 - batchStart == static_cast<int>(ws.batchJobs))
+            flush(job + 1);
+    }
+    flush(last);
+}
+
+// Rows of the energy stage processed per block, sized so that the
+// block's weighting scratch stays cache resident
+static int energyBlockRows(int width)
+{
+    return std::max(1, 8192 / std::max(1, width));
+}
+
+// Most jobs (two planes each) a worker inverts in one batched transform.
+// Each costs the worker two more planes of products and half spectra.
+static const size_t inverseBatchJobs = 4;
+
+// (Re)allocate m only if its shape or type differs; true if it did, and
+// bytes is increased by the new size
+static bool ensureMat(Mat& m, int rows, int cols, int type, size_t& bytes)
+{
+    if (m.rows == rows && m.cols == cols && m.type() == type)
+        return false;
+    m.create(rows, cols, type);
+    bytes += m.total() * m.elemSize();
+    return true;
+}
+
+template<typename T> static std::vector<const T*>& rowPointers(WorkerScratch& scratch);
+template<> std::vector<const float*>& rowPointers<float>(WorkerScratch& scratch) { return scratch.rowsF; }
+template<> std::vector<const double*>& rowPointers<double>(WorkerScratch& scratch) { return scratch.rowsD; }
+
+// Size every buffer used by calc and feature for the current image size,
+// depth and worker count. Does nothing once the shapes are settled, so
+// steady-state frames reallocate no workspace buffer.
+void PhaseCongruency::prepareWorkspace()
+{
+    const int workers = workerCount();
+    const size_t group = std::min(norient, std::max<size_t>(1, (workers + nscale - 1) / nscale));
+    const int type = CV_MAKETYPE(depth, 1);
+    const int dft_M = bank->key.rows;
+    const int dft_N = bank->key.cols;
+    const cv::Rect roi(0, 0, size.width, size.height);
+    size_t& allocations = ws.allocations;
+    size_t& bytes = ws.allocatedBytes;
+
+    if (ensureMat(ws.padded, dft_M, dft_N, type, bytes))
+    {
+        ws.padded.setTo(0); // the border stays zero, frames only fill roi
+        allocations++;
+    }
+    allocations += ensureMat(ws.spectrum, dft_M, dft_N, type, bytes);
+
+    // One buffer for the responses of a group, so that the planes of
+    // consecutive jobs can be the output of one batched inverse
+    const int jobs = static_cast<int>(group * nscale);
+    if (ensureMat(ws.responses, 2 * jobs * dft_M, dft_N, type, bytes) || ws.responseRe.size() != group * nscale)
+    {
+        ws.responseRe.resize(group * nscale);
+        ws.responseIm.resize(group * nscale);
+        ws.eoRe.resize(group * nscale);
+        ws.eoIm.resize(group * nscale);
+        for (int job = 0; job < jobs; job++)
+        {
+            ws.responseRe[job] = ws.responses.rowRange(2 * job * dft_M, (2 * job + 1) * dft_M);
+            ws.responseIm[job] = ws.responses.rowRange((2 * job + 1) * dft_M, (2 * job + 2) * dft_M);
+            ws.eoRe[job] = ws.responseRe[job](roi);
+            ws.eoIm[job] = ws.responseIm[job](roi);
+        }
+        allocations++;
+    }
+    ws.group = group;
+
+    // Jobs per batched inverse: no more than a worker gets per group.
+    // cv::dft has no batched 2-D inverse, so it keeps a single plane.
+    ws.batchJobs = fftBackend == PC_FFT_OPENCV ? 1
+        : std::min<size_t>(inverseBatchJobs, (group * nscale + workers - 1) / workers);
+
+    if (ws.pc.size() != norient)
+    {
+        ws.pc.resize(norient);
+        allocations++;
+    }
+
+    if (ensureMat(ws.weights, 5, static_cast<int>(norient), CV_64F, bytes))
+    {
+        // Covariance weights cos^2 * 2/n, sin^2 * 2/n and cos*sin * 4/n,
+        // then cos and sin themselves
+        const double angle_const = CV_PI / static_cast<double>(norient);
+        for (size_t o = 0; o < norient; o++)
+        {
+            const double angl = static_cast<double>(o) * angle_const;
+            ws.weights.at<double>(0, static_cast<int>(o)) = cos(angl) * cos(angl) * 2.0 / norient;
+            ws.weights.at<double>(1, static_cast<int>(o)) = sin(angl) * sin(angl) * 2.0 / norient;
+            ws.weights.at<double>(2, static_cast<int>(o)) = cos(angl) * sin(angl) * 4.0 / norient;
+            ws.weights.at<double>(3, static_cast<int>(o)) = cos(angl);
+            ws.weights.at<double>(4, static_cast<int>(o)) = sin(angl);
+        }
+        allocations++;
+    }
+    allocations += ensureMat(ws.typedWeights, 5, static_cast<int>(norient), type, bytes);
+    ws.weights.convertTo(ws.typedWeights, depth);
+
+    // Pyramid level of every scale: the deepest crop whose guard band the
+    // filter does not reach
+    ws.scaleLevel.assign(nscale, 0);
+    ws.levelSize.assign(1, cv::Size(dft_N, dft_M));
+    const double r = std::min(dft_M / 2, dft_N / 2);
+    for (size_t scale = 0; pyramid && scale < nscale; scale++)
+    {
+        const double wavelength = pcc.minwavelength * pow(pcc.mult, static_cast<double>(scale));
+        for (int k = 1; ; k++)
+        {
+            const cv::Size crop(evenDFTSize(2 * ((dft_N + (2 << k) - 1) / (2 << k))),
+                                evenDFTSize(2 * ((dft_M + (2 << k) - 1) / (2 << k))));
+            if (crop.width >= dft_N || crop.height >= dft_M)
+                break;
+            const double radius = std::min(crop.width / 2, crop.height / 2) / r;
+            if (radialTail(radius * pyramidGuard, wavelength, pcc.sigma) > pyramidTolerance)
+                break;
+            if (static_cast<int>(ws.levelSize.size()) <= k)
+                ws.levelSize.push_back(crop);
+            ws.scaleLevel[scale] = k;
+        }
+    }
+
+    // Transforms of every level, planned once per process by the backend;
+    // the half-spectrum scratch of a level-0 batch is large enough for all
+    // levels
+    ws.fft.resize(ws.levelSize.size());
+    for (size_t k = 0; k < ws.levelSize.size(); k++)
+    {
+        const std::shared_ptr<const PhaseCongruencyFFT>& fft = ws.fft[k];
+        if (!fft || fft->backend() != fftBackend || fft->size() != ws.levelSize[k] || fft->type() != type)
+            ws.fft[k] = PhaseCongruencyFFT::acquire(fftBackend, ws.levelSize[k].height, ws.levelSize[k].width, depth);
+    }
+
+    // Pyramid mode: the spectrum is cropped to every level once per frame,
+    // and the filters of the decimated scales once per bank, so the
+    // products of those scales are formed on the crop only
+    const size_t levels = ws.levelSize.size();
+    if (ws.levelSpectrum.size() != levels)
+    {
+        ws.levelSpectrum.resize(levels);
+        allocations++;
+    }
+    for (size_t k = 1; k < levels; k++)
+        allocations += ensureMat(ws.levelSpectrum[k], ws.levelSize[k].height, ws.levelSize[k].width, type, bytes);
+    if (ws.levelBank != bank || ws.croppedLevel != ws.scaleLevel)
+    {
+        const bool compactBank = bank->key.compact;
+        auto crop = [&](const Mat& src, Mat& dst, size_t level) {
+            allocations += ensureMat(dst, ws.levelSize[level].height, ws.levelSize[level].width, type, bytes);
+            if (depth == CV_32F)
+                cropSpectrum<float>(src, dst);
+            else
+                cropSpectrum<double>(src, dst);
+        };
+        ws.levelEven.resize(compactBank ? 0 : nscale * norient);
+        ws.levelOdd.resize(compactBank ? 0 : nscale * norient);
+        ws.levelRadial.resize(compactBank ? nscale : 0);
+        ws.levelAngularEven.resize(compactBank ? levels * norient : 0);
+        ws.levelAngularOdd.resize(compactBank ? levels * norient : 0);
+        for (size_t scale = 0; scale < nscale; scale++)
+        {
+            const size_t level = ws.scaleLevel[scale];
+            if (level == 0)
+                continue;
+            if (compactBank)
+            {
+                crop(bank->radial[scale], ws.levelRadial[scale], level);
+                continue;
+            }
+            for (size_t o = 0; o < norient; o++)
+            {
+                crop(bank->even[nscale * o + scale], ws.levelEven[nscale * o + scale], level);
+                crop(bank->odd[nscale * o + scale], ws.levelOdd[nscale * o + scale], level);
+            }
+        }
+        for (size_t k = 1; compactBank && k < levels; k++)
+        {
+            for (size_t o = 0; o < norient; o++)
+            {
+                crop(bank->angularEven[o], ws.levelAngularEven[norient * k + o], k);
+                crop(bank->angularOdd[o], ws.levelAngularOdd[norient * k + o], k);
+            }
+        }
+        ws.levelBank = bank;
+        ws.croppedLevel = ws.scaleLevel;
+    }
+
+    const int batchPlanes = 2 * static_cast<int>(ws.batchJobs);
+    const cv::Size fftScratch = ws.fft[0]->scratchSize();
+    const cv::Size batchScratch = ws.fft[0]->scratchSize(batchPlanes);
+    const int fftScratchType = CV_MAKETYPE(depth, 2);
+    if (!fftScratch.empty())
+        allocations += ensureMat(ws.fftScratch, fftScratch.height, fftScratch.width, fftScratchType, bytes);
+
+    if (ws.workers.size() != static_cast<size_t>(workers))
+    {
+        ws.workers.resize(workers);
+        allocations++;
+    }
+    const int block = std::min(size.height, energyBlockRows(size.width));
+    const size_t pointers = 2 * std::max(nscale, norient);
+    for (WorkerScratch& scratch : ws.workers)
+    {
+        allocations += ensureMat(scratch.products, batchPlanes * dft_M, dft_N, type, bytes);
+        allocations += ensureMat(scratch.arg, block, size.width, type, bytes);
+        allocations += ensureMat(scratch.sumAn, block, size.width, type, bytes);
+        allocations += ensureMat(scratch.moments, 2, size.width, type, bytes);
+        allocations += ensureMat(scratch.window, 3, size.width, type, bytes);
+        allocations += ensureMat(scratch.normal, 1, size.width, CV_32FC1, bytes);
+        if (scratch.levelProduct.size() < ws.levelSize.size())
+        {
+            scratch.levelProduct.resize(ws.levelSize.size());
+            scratch.levelResponse.resize(ws.levelSize.size());
+            allocations++;
+        }
+        for (size_t k = 1; k < ws.levelSize.size(); k++)
+        {
+            allocations += ensureMat(scratch.levelProduct[k], ws.levelSize[k].height, ws.levelSize[k].width, type, bytes);
+            allocations += ensureMat(scratch.levelResponse[k], ws.levelSize[k].height, ws.levelSize[k].width, type, bytes);
+        }
+        if (!batchScratch.empty())
+            allocations += ensureMat(scratch.fftScratch, batchScratch.height, batchScratch.width, fftScratchType, bytes);
+        if (scratch.rowsF.size() != pointers)
+        {
+            scratch.rowsF.resize(pointers);
+            scratch.rowsD.resize(pointers);
+            allocations++;
+        }
+    }
+}
+
+size_t PhaseCongruency::workspaceAllocations() const
+{
+    return ws.allocations;
+}
+
+PhaseCongruencyStats PhaseCongruency::stats() const
+{
+    PhaseCongruencyStats result;
+    if (stageProfiler)
+        stageProfiler->fill(result);
+    result.allocations = ws.allocations;
+    result.bytesAllocated = ws.allocatedBytes;
+    for (const auto& lane : lanes)
+    {
+        result.allocations += lane->ws.allocations;
+        result.bytesAllocated += lane->ws.allocatedBytes;
+    }
+    return result;
+}
+
+void PhaseCongruency::resetStats()
+{
+    if (stageProfiler)
+        stageProfiler->reset();
+}
+
+void PhaseCongruency::setTracing(bool enabled)
+{
+    if (stageProfiler)
+        stageProfiler->setTracing(enabled);
+}
+
+bool PhaseCongruency::writeTrace(const std::string& path) const
+{
+    return stageProfiler && stageProfiler->writeTrace(path);
+}
+
+void PhaseCongruency::shareProfiler(const PhaseCongruency& other)
+{
+    stageProfiler = other.stageProfiler;
+}
+
+// Noise threshold of an orientation from the mean amplitude of its
+// finest-scale response
+static double noiseThreshold(double meanAmplitude, size_t nscale, const PhaseCongruencyConst& pcc)
+{
+    const double tau = meanAmplitude / sqrt(log(4.0));
+    const double mt = 1.0 * pow(pcc.mult, nscale);
+    const double totalTau = tau * (1.0 - 1.0 / mt) / (1.0 - 1.0 / pcc.mult);
+    const double m = totalTau * sqrt(CV_PI / 2.0);
+    const double n = totalTau * sqrt((4 - CV_PI) / 2.0);
+    return m + pcc.k * n;
+}
+
+// Sum of the amplitudes of one response over region
+template<typename T>
+static double amplitudeSum(const Mat& re, const Mat& im, const cv::Rect& region)
+{
+    double sum = 0;
+    for (int y = region.y; y < region.br().y; y++)
+        sum += pckernel::magnitudeSum(re.ptr<T>(y) + region.x, im.ptr<T>(y) + region.x, region.width);
+    return sum;
+}
+
+// noise < 0 estimates the threshold from this image's finest scale
+template<typename T>
+static void fusedOrientationEnergy(const Mat* eoRe, const Mat* eoIm, size_t nscale,
+                                   const PhaseCongruencyConst& pcc, double noise, WorkerScratch& scratch,
+                                   Mat& _pc, Mat* sumE, Mat* sumO)
+{
+    const int width = eoRe[0].cols;
+    const int height = eoRe[0].rows;
+
+    //here to do noise threshold calculation
+    if (noise < 0)
+    {
+        const double sumMag = amplitudeSum<T>(eoRe[0], eoIm[0], cv::Rect(0, 0, width, height));
+        noise = noiseThreshold(sumMag / (static_cast<double>(width) * height), nscale, pcc);
+    }
+
+    _pc.create(height, width, DataType<T>::type);
+
+    Mat& arg = scratch.arg;
+    Mat& sumAn = scratch.sumAn;
+    const int block = arg.rows;
+    const T** re = rowPointers<T>(scratch).data();
+    const T** im = re + nscale;
+
+    for (int y0 = 0; y0 < height; y0 += block)
+    {
+        const int rows = std::min(block, height - y0);
+        for (int r = 0; r < rows; r++)
+        {
+            for (size_t scale = 0; scale < nscale; scale++)
+            {
+                re[scale] = eoRe[scale].ptr<T>(y0 + r);
+                im[scale] = eoIm[scale].ptr<T>(y0 + r);
+            }
+            pckernel::energyRow<T>(re, im, static_cast<int>(nscale), width,
+                                   T(noise), T(pcc.epsilon), T(pcc.cutOff), T(pcc.g),
+                                   _pc.ptr<T>(y0 + r), arg.ptr<T>(r), sumAn.ptr<T>(r));
+            if (sumE != nullptr)
+            {
+                pckernel::sumRows<T>(re, static_cast<int>(nscale), width, sumE->ptr<T>(y0 + r));
+                pckernel::sumRows<T>(im, static_cast<int>(nscale), width, sumO->ptr<T>(y0 + r));
+            }
+        }
+
+        Mat argBlock = arg.rowRange(0, rows);
+        exp(argBlock, argBlock);
+
+        //PC
+        for (int r = 0; r < rows; r++)
+            pckernel::weightRow<T>(_pc.ptr<T>(y0 + r), arg.ptr<T>(r), sumAn.ptr<T>(r), width);
+    }
+}
+
+// Phase congruency of orientation o from its nscale even/odd responses.
+// The noise threshold is the one set for tiled mode, if any.
+void PhaseCongruency::orientationEnergy(size_t o, const Mat* eoRe, const Mat* eoIm, WorkerScratch& scratch,
+                                        Mat& _pc, Mat* sumE, Mat* sumO) const
+{
+    const double noise = fixedNoise.empty() ? -1.0 : fixedNoise[o];
+    if (depth == CV_32F)
+        fusedOrientationEnergy<float>(eoRe, eoIm, nscale, pcc, noise, scratch, _pc, sumE, sumO);
+    else
+        fusedOrientationEnergy<double>(eoRe, eoIm, nscale, pcc, noise, scratch, _pc, sumE, sumO);
+}
+
+// Tiled mode: per orientation, the sum over region of src of the
+// finest-scale amplitude, from which the noise threshold is estimated
+void PhaseCongruency::finestAmplitudeSums(const Mat& src, const cv::Rect& region, std::vector<double>& sums)
+{
+    CV_Assert(src.size() == size);
+    prepareWorkspace();
+
+    Mat image = ws.padded(cv::Rect(0, 0, size.width, size.height));
+    src.convertTo(image, depth, 1.0 / 255.0);
+    {
+        PC_PROFILE_SCOPE(profiler(), PC_STAGE_FFT);
+        ws.fft[0]->forward(ws.padded, ws.spectrum, ws.fftScratch);
+        const int level = ws.scaleLevel[0];
+        if (level > 0 && depth == CV_32F)
+            cropSpectrum<float>(ws.spectrum, ws.levelSpectrum[level]);
+        else if (level > 0)
+            cropSpectrum<double>(ws.spectrum, ws.levelSpectrum[level]);
+    }
+
+    PC_PROFILE_SCOPE(profiler(), PC_STAGE_FILTER);
+    sums.assign(norient, 0.0);
+    for (size_t o = 0; o < norient; o++)
+    {
+        filterResponse(ws.spectrum, nscale * o, ws.workers[0], ws.responseRe[0], ws.responseIm[0]);
+        sums[o] = depth == CV_32F ? amplitudeSum<float>(ws.responseRe[0], ws.responseIm[0], region)
+                                  : amplitudeSum<double>(ws.responseRe[0], ws.responseIm[0], region);
+    }
+}
+
+//Phase congruency calculation
+void PhaseCongruency::calc(InputArray _src, std::vector<cv::Mat> &_pc)
+{
+    PC_PROFILE_FRAME(frameProfiler(), frameDepth);
+    calc(_src, _pc, false);
+}
+
+// energySums also keeps the per-orientation sums of the even and odd
+// responses over scales in ws.sumE / ws.sumO, for the feature type
+void PhaseCongruency::calc(InputArray _src, std::vector<cv::Mat> &_pc, bool energySums)
+{
+    Mat src = _src.getMat();
+
+    CV_Assert(src.size() == size);
+
+    prepareWorkspace();
+    _pc.resize(norient);
+
+    if (energySums)
+    {
+        ws.sumE.resize(norient);
+        ws.sumO.resize(norient);
+        for (size_t o = 0; o < norient; o++)
+        {
+            ws.allocations += ensureMat(ws.sumE[o], size.height, size.width, CV_MAKETYPE(depth, 1), ws.allocatedBytes);
+            ws.allocations += ensureMat(ws.sumO[o], size.height, size.width, CV_MAKETYPE(depth, 1), ws.allocatedBytes);
+        }
+    }
+
+    // The zero-padded input: the image goes straight into the top-left
+    // corner of the optimally sized buffer
+    {
+        PC_PROFILE_SCOPE(profiler(), PC_STAGE_FFT);
+        Mat image = ws.padded(cv::Rect(0, 0, size.width, size.height));
+        src.convertTo(image, depth, 1.0 / 255.0);
+
+        // Real input: the forward transform yields the CCS-packed half spectrum
+        ws.fft[0]->forward(ws.padded, ws.spectrum, ws.fftScratch);
+
+        // Pyramid mode: the low-frequency band of every level
+        for (size_t k = 1; k < ws.levelSize.size(); k++)
+        {
+            if (depth == CV_32F)
+                cropSpectrum<float>(ws.spectrum, ws.levelSpectrum[k]);
+            else
+                cropSpectrum<double>(ws.spectrum, ws.levelSpectrum[k]);
+        }
+    }
+
+    // Orientations are filtered in groups large enough to give every worker
+    // a (orientation, scale) job; only one group of responses is alive.
+    // Worker w owns ws.workers[w] and takes a contiguous run of jobs, whose
+    // inverses it batches.
+    const int workers = static_cast<int>(ws.workers.size());
+    const size_t group = ws.group;
+
+    for (size_t o0 = 0; o0 < norient; o0 += group)
+    {
+        const int count = static_cast<int>(std::min(group, norient - o0));
+        const int jobs = count * static_cast<int>(nscale);
+
+        {
+            PC_PROFILE_SCOPE(profiler(), PC_STAGE_FILTER);
+            const int active = std::min(workers, jobs);
+            parallel_for_(Range(0, active), [&](const Range& range) {
+                for (int w = range.start; w < range.end; w++)
+                    filterJobs(ws.spectrum, o0, jobs * w / active, jobs * (w + 1) / active, ws.workers[w]);
+            });
+        }
+
+        PC_PROFILE_SCOPE(profiler(), PC_STAGE_ENERGY);
+        parallel_for_(Range(0, std::min(workers, count)), [&](const Range& range) {
+            for (int w = range.start; w < range.end; w++)
+                for (int i = w; i < count; i += workers)
+                    orientationEnergy(o0 + i, &ws.eoRe[nscale * i], &ws.eoIm[nscale * i], ws.workers[w], _pc[o0 + i],
+                                      energySums ? &ws.sumE[o0 + i] : nullptr,
+                                      energySums ? &ws.sumO[o0 + i] : nullptr);
+        });
+    }//orientation
+}
+
+// Covariance of the oriented phase congruency and its principal moments in
+// one pass over row bands: maximum moment -> edges, minimum -> corners
+template<typename T>
+static void fusedMoments(const std::vector<Mat>& _pc, const Mat& weights, std::vector<WorkerScratch>& workers,
+                         Mat& edges, Mat& corners)
+{
+    const int norient = static_cast<int>(_pc.size());
+    const int width = edges.cols;
+    const int height = edges.rows;
+    const int bands = static_cast<int>(workers.size());
+
+    parallel_for_(Range(0, bands), [&](const Range& range) {
+        for (int w = range.start; w < range.end; w++)
+        {
+            T* maxMoment = workers[w].moments.ptr<T>(0);
+            T* minMoment = workers[w].moments.ptr<T>(1);
+            const T** rows = rowPointers<T>(workers[w]).data();
+            for (int y = height * w / bands; y < height * (w + 1) / bands; y++)
+            {
+                for (int o = 0; o < norient; o++)
+                    rows[o] = _pc[o].ptr<T>(y);
+                pckernel::momentRow<T>(rows, norient, weights.ptr<T>(0), weights.ptr<T>(1), weights.ptr<T>(2),
+                                       width, maxMoment, minMoment);
+                pckernel::toU8Row<T>(maxMoment, width, edges.ptr<uchar>(y));
+                pckernel::toU8Row<T>(minMoment, width, corners.ptr<uchar>(y));
+            }
+        }
+    });
+}
+
+//Build up covariance data for every point
+void PhaseCongruency::feature(std::vector<cv::Mat>& _pc, cv::OutputArray _edges, cv::OutputArray _corners)
+{
+    PC_PROFILE_FRAME(frameProfiler(), frameDepth);
+    PC_PROFILE_SCOPE(profiler(), PC_STAGE_MOMENTS);
+    _edges.create(size, CV_8UC1);
+    _corners.create(size, CV_8UC1);
+    auto edges = _edges.getMat();
+    auto corners = _corners.getMat();
+
+    prepareWorkspace();
+    if (depth == CV_32F)
+        fusedMoments<float>(_pc, ws.typedWeights, ws.workers, edges, corners);
+    else
+        fusedMoments<double>(_pc, ws.typedWeights, ws.workers, edges, corners);
+}
+
+// The float maps of compute in one pass over row bands
+template<typename T>
+static void fusedResult(const std::vector<Mat>& _pc, const std::vector<Mat>& sumE, const std::vector<Mat>& sumO,
+                        const Mat& weights, std::vector<WorkerScratch>& workers, int outputs,
+                        PhaseCongruencyResult& result)
+{
+    const int norient = static_cast<int>(_pc.size());
+    const int width = _pc[0].cols;
+    const int height = _pc[0].rows;
+    const int bands = static_cast<int>(workers.size());
+
+    parallel_for_(Range(0, bands), [&](const Range& range) {
+        for (int w = range.start; w < range.end; w++)
+        {
+            T* maxMoment = workers[w].moments.ptr<T>(0);
+            T* minMoment = workers[w].moments.ptr<T>(1);
+            const T** rows = rowPointers<T>(workers[w]).data();
+            for (int y = height * w / bands; y < height * (w + 1) / bands; y++)
+            {
+                for (int o = 0; o < norient; o++)
+                    rows[o] = _pc[o].ptr<T>(y);
+
+                if (outputs & (PC_MAX_MOMENT | PC_MIN_MOMENT))
+                {
+                    pckernel::momentRow<T>(rows, norient, weights.ptr<T>(0), weights.ptr<T>(1), weights.ptr<T>(2),
+                                           width, maxMoment, minMoment);
+                    if (outputs & PC_MAX_MOMENT)
+                        std::copy(maxMoment, maxMoment + width, result.maxMoment.ptr<float>(y));
+                    if (outputs & PC_MIN_MOMENT)
+                        std::copy(minMoment, minMoment + width, result.minMoment.ptr<float>(y));
+                }
+                if (outputs & PC_ORIENTATION)
+                    pckernel::orientationRow<T>(rows, norient, weights.ptr<T>(0), weights.ptr<T>(1), weights.ptr<T>(2),
+                                                width, result.orientation.ptr<float>(y));
+                if (outputs & PC_FEATURE_TYPE)
+                {
+                    for (int o = 0; o < norient; o++)
+                    {
+                        rows[o] = sumE[o].ptr<T>(y);
+                        rows[norient + o] = sumO[o].ptr<T>(y);
+                    }
+                    pckernel::featureTypeRow<T>(rows, rows + norient, norient, weights.ptr<T>(3), weights.ptr<T>(4),
+                                                width, result.featureType.ptr<float>(y));
+                }
+            }
+        }
+    });
+}
+
+void PhaseCongruency::compute(InputArray _src, PhaseCongruencyResult& result, int outputs)
+{
+    PC_PROFILE_FRAME(frameProfiler(), frameDepth);
+    calc(_src, result.pc, (outputs & PC_FEATURE_TYPE) != 0);
+
+    PC_PROFILE_SCOPE(profiler(), PC_STAGE_MOMENTS);
+
+    const struct { int flag; Mat* map; } maps[] = {
+        { PC_MAX_MOMENT, &result.maxMoment }, { PC_MIN_MOMENT, &result.minMoment },
+        { PC_ORIENTATION, &result.orientation }, { PC_FEATURE_TYPE, &result.featureType } };
+    for (const auto& m : maps)
+    {
+        if (outputs & m.flag)
+            m.map->create(size, CV_32FC1);
+        else
+            m.map->release();
+    }
+
+    if (depth == CV_32F)
+        fusedResult<float>(result.pc, ws.sumE, ws.sumO, ws.typedWeights, ws.workers, outputs, result);
+    else
+        fusedResult<double>(result.pc, ws.sumE, ws.sumO, ws.typedWeights, ws.workers, outputs, result);
+}
+
+// Moments and non-maximum suppression in one pass over row bands. Each
+// band keeps a rolling window of three max moment rows, recomputing the
+// row above and below it, so the full moment map is never stored.
+template<typename T>
+static void fusedThinning(const std::vector<Mat>& _pc, const Mat& weights, std::vector<WorkerScratch>& workers,
+                          T low, T high, Mat& labels, Mat* subpixel)
+{
+    const int norient = static_cast<int>(_pc.size());
+    const int width = labels.cols;
+    const int height = labels.rows;
+    const int bands = static_cast<int>(workers.size());
+
+    parallel_for_(Range(0, bands), [&](const Range& range) {
+        for (int w = range.start; w < range.end; w++)
+        {
+            WorkerScratch& scratch = workers[w];
+            T* minMoment = scratch.moments.ptr<T>(1);
+            const T** rows = rowPointers<T>(scratch).data();
+
+            auto momentsOf = [&](int y, T* out) {
+                if (y < 0 || y >= height)
+                {
+                    std::fill(out, out + width, T(0));
+                    return;
+                }
+                for (int o = 0; o < norient; o++)
+                    rows[o] = _pc[o].ptr<T>(y);
+                pckernel::momentRow<T>(rows, norient, weights.ptr<T>(0), weights.ptr<T>(1), weights.ptr<T>(2),
+                                       width, out, minMoment);
+            };
+
+            const int y0 = height * w / bands;
+            const int y1 = height * (w + 1) / bands;
+            if (y0 < y1)
+            {
+                momentsOf(y0 - 1, scratch.window.ptr<T>((y0 + 2) % 3));
+                momentsOf(y0, scratch.window.ptr<T>(y0 % 3));
+            }
+            for (int y = y0; y < y1; y++)
+            {
+                momentsOf(y + 1, scratch.window.ptr<T>((y + 1) % 3));
+
+                for (int o = 0; o < norient; o++)
+                    rows[o] = _pc[o].ptr<T>(y);
+                pckernel::orientationRow<T>(rows, norient, weights.ptr<T>(0), weights.ptr<T>(1), weights.ptr<T>(2),
+                                            width, scratch.normal.ptr<float>(0));
+
+                const T* window[3] = { scratch.window.ptr<T>((y + 2) % 3), scratch.window.ptr<T>(y % 3),
+                                       scratch.window.ptr<T>((y + 1) % 3) };
+                pckernel::suppressRow<T>(window, scratch.normal.ptr<float>(0), width, low, high,
+                                         labels.ptr<uchar>(y), subpixel != nullptr ? subpixel->ptr<float>(y) : nullptr);
+            }
+        }
+    });
+}
+
+// Hysteresis on the labels of fusedThinning: strong pixels and the weak
+// pixels 8-connected to them become 255, everything else 0
+static void hysteresis(Mat& labels, std::vector<cv::Point>& stack)
+{
+    const int width = labels.cols;
+    const int height = labels.rows;
+    stack.clear();
+
+    for (int y = 0; y < height; y++)
+    {
+        uchar* row = labels.ptr<uchar>(y);
+        for (int x = 0; x < width; x++)
+        {
+            if (row[x] != 2)
+                continue;
+            row[x] = 255;
+            stack.push_back(cv::Point(x, y));
+            while (!stack.empty())
+            {
+                const cv::Point p = stack.back();
+                stack.pop_back();
+                for (int ny = std::max(p.y - 1, 0); ny <= std::min(p.y + 1, height - 1); ny++)
+                {
+                    uchar* neighbours = labels.ptr<uchar>(ny);
+                    for (int nx = std::max(p.x - 1, 0); nx <= std::min(p.x + 1, width - 1); nx++)
+                    {
+                        if (neighbours[nx] == 1 || neighbours[nx] == 2)
+                        {
+                            neighbours[nx] = 255;
+                            stack.push_back(cv::Point(nx, ny));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    for (int y = 0; y < height; y++)
+    {
+        uchar* row = labels.ptr<uchar>(y);
+        for (int x = 0; x < width; x++)
+            row[x] = row[x] == 255 ? 255 : 0;
+    }
+}
+
+void PhaseCongruency::thinEdges(InputArray _src, double low, double high, OutputArray _mask,
+                                std::vector<PhaseCongruencyEdgel>* edgels)
+{
+    PC_PROFILE_FRAME(frameProfiler(), frameDepth);
+    calc(_src, ws.pc);
+
+    PC_PROFILE_SCOPE(profiler(), PC_STAGE_MOMENTS);
+
+    ws.allocations += ensureMat(ws.labels, size.height, size.width, CV_8UC1, ws.allocatedBytes);
+    Mat* subpixel = nullptr;
+    if (edgels != nullptr)
+    {
+        ws.allocations += ensureMat(ws.subpixel, size.height, size.width, CV_32FC3, ws.allocatedBytes);
+        subpixel = &ws.subpixel;
+    }
+
+    if (depth == CV_32F)
+        fusedThinning<float>(ws.pc, ws.typedWeights, ws.workers, float(low), float(high), ws.labels, subpixel);
+    else
+        fusedThinning<double>(ws.pc, ws.typedWeights, ws.workers, low, high, ws.labels, subpixel);
+
+    hysteresis(ws.labels, ws.stack);
+    ws.labels.copyTo(_mask);
+
+    if (edgels == nullptr)
+        return;
+    edgels->clear();
+    for (int y = 0; y < size.height; y++)
+    {
+        const uchar* mask = ws.labels.ptr<uchar>(y);
+        const float* sub = ws.subpixel.ptr<float>(y);
+        for (int x = 0; x < size.width; x++)
+        {
+            if (mask[x] == 0)
+                continue;
+            const float offset = sub[3 * x];
+            const float angle = sub[3 * x + 1];
+            PhaseCongruencyEdgel edgel;
+            edgel.position = cv::Point2f(x + offset * std::cos(angle), y + offset * std::sin(angle));
+            edgel.orientation = angle;
+            edgel.strength = sub[3 * x + 2];
+            edgels->push_back(edgel);
+        }
+    }
+}
+
+// Moments and 3x3 local maxima of the min moment in one pass over row
+// bands, with a rolling window of three min moment rows as in
+// fusedThinning. Each band collects its candidates in its scratch.
+template<typename T>
+static void fusedCorners(const std::vector<Mat>& _pc, const Mat& weights, std::vector<WorkerScratch>& workers,
+                         T threshold, float keypointSize)
+{
+    const int norient = static_cast<int>(_pc.size());
+    const int width = _pc[0].cols;
+    const int height = _pc[0].rows;
+    const int bands = static_cast<int>(workers.size());
+
+    parallel_for_(Range(0, bands), [&](const Range& range) {
+        for (int w = range.start; w < range.end; w++)
+        {
+            WorkerScratch& scratch = workers[w];
+            T* maxMoment = scratch.moments.ptr<T>(0);
+            const T** rows = rowPointers<T>(scratch).data();
+            scratch.corners.clear();
+
+            auto momentsOf = [&](int y, T* out) {
+                if (y < 0 || y >= height)
+                {
+                    std::fill(out, out + width, T(0));
+                    return;
+                }
+                for (int o = 0; o < norient; o++)
+                    rows[o] = _pc[o].ptr<T>(y);
+                pckernel::momentRow<T>(rows, norient, weights.ptr<T>(0), weights.ptr<T>(1), weights.ptr<T>(2),
+                                       width, maxMoment, out);
+            };
+
+            const int y0 = height * w / bands;
+            const int y1 = height * (w + 1) / bands;
+            if (y0 < y1)
+            {
+                momentsOf(y0 - 1, scratch.window.ptr<T>((y0 + 2) % 3));
+                momentsOf(y0, scratch.window.ptr<T>(y0 % 3));
+            }
+            for (int y = y0; y < y1; y++)
+            {
+                momentsOf(y + 1, scratch.window.ptr<T>((y + 1) % 3));
+
+                const T* above = scratch.window.ptr<T>((y + 2) % 3);
+                const T* mid = scratch.window.ptr<T>(y % 3);
+                const T* below = scratch.window.ptr<T>((y + 1) % 3);
+                for (int x = 0; x < width; x++)
+                {
+                    const T v = mid[x];
+                    if (v < threshold)
+                        continue;
+
+                    // Strictly above the neighbours before, at least equal
+                    // to those after, so plateaus give one corner
+                    const int xl = std::max(x - 1, 0);
+                    const int xr = std::min(x + 1, width - 1);
+                    if ((x > 0 && v <= mid[xl]) || v < mid[xr] ||
+                        v <= above[xl] || v <= above[x] || v <= above[xr] ||
+                        v < below[xl] || v < below[x] || v < below[xr])
+                        continue;
+
+                    scratch.corners.push_back(cv::KeyPoint(static_cast<float>(x), static_cast<float>(y),
+                                                           keypointSize, -1.f, static_cast<float>(v)));
+                }
+            }
+        }
+    });
+}
+
+void PhaseCongruency::detectCorners(InputArray _src, const PhaseCongruencyCornerParams& params,
+                                    std::vector<cv::KeyPoint>& keypoints)
+{
+    PC_PROFILE_FRAME(frameProfiler(), frameDepth);
+    calc(_src, ws.pc);
+
+    PC_PROFILE_SCOPE(profiler(), PC_STAGE_MOMENTS);
+
+    // Keypoint size: the largest wavelength, the support of the feature
+    const float keypointSize = static_cast<float>(pcc.minwavelength * pow(pcc.mult, static_cast<double>(nscale) - 1.0));
+    if (depth == CV_32F)
+        fusedCorners<float>(ws.pc, ws.typedWeights, ws.workers, params.threshold, keypointSize);
+    else
+        fusedCorners<double>(ws.pc, ws.typedWeights, ws.workers, params.threshold, keypointSize);
+
+    keypoints.clear();
+    for (const WorkerScratch& scratch : ws.workers)
+        keypoints.insert(keypoints.end(), scratch.corners.begin(), scratch.corners.end());
+
+    if (params.gridSize <= 0 && (params.maxCorners <= 0 || static_cast<int>(keypoints.size()) <= params.maxCorners))
+        return;
+
+    // Strongest first; stable so equal responses keep raster order
+    std::stable_sort(keypoints.begin(), keypoints.end(),
+                     [](const cv::KeyPoint& a, const cv::KeyPoint& b) { return a.response > b.response; });
+
+    if (params.gridSize > 0)
+    {
+        const int cellsX = (size.width + params.gridSize - 1) / params.gridSize;
+        const int cellsY = (size.height + params.gridSize - 1) / params.gridSize;
+        ws.cellCounts.assign(static_cast<size_t>(cellsX) * cellsY, 0);
+
+        size_t kept = 0;
+        for (const cv::KeyPoint& kp : keypoints)
+        {
+            const int cell = static_cast<int>(kp.pt.y) / params.gridSize * cellsX + static_cast<int>(kp.pt.x) / params.gridSize;
+            if (ws.cellCounts[cell]++ < params.maxPerCell)
+                keypoints[kept++] = kp;
+        }
+        keypoints.resize(kept);
+    }
+
+    if (params.maxCorners > 0 && static_cast<int>(keypoints.size()) > params.maxCorners)
+        keypoints.resize(params.maxCorners);
+}
+
+//Build up covariance data for every point
+void PhaseCongruency::feature(InputArray _src, cv::OutputArray _edges, cv::OutputArray _corners)
+{
+    PC_PROFILE_FRAME(frameProfiler(), frameDepth);
+    calc(_src, ws.pc);
+    feature(ws.pc, _edges, _corners);
+}
+
+// Batch lanes mirror this instance's parameters and share its bank; they
+// are kept between batches so their workspaces are reused
+// Lanes count frames only when each runs whole images (batches), not
+// tiles of a frame counted by the entry point
+void PhaseCongruency::prepareLanes(size_t count, bool countFrames)
+{
+    if (lanes.size() < count)
+        lanes.resize(count);
+    for (size_t l = 0; l < count; l++)
+    {
+        if (!lanes[l])
+            lanes[l].reset(new PhaseCongruency(this));
+        PhaseCongruency& lane = *lanes[l];
+        lane.pcc = pcc;
+        lane.compact = compact;
+        lane.pyramid = pyramid;
+        lane.fftBackend = fftBackend;
+        lane.bank = bank;
+        lane.nthreads = 1;
+        lane.stageProfiler = stageProfiler;
+        lane.countFrames = countFrames;
+        lane.fixedNoise = fixedNoise;
+        lane.prepareWorkspace();
+    }
+}
+
+void PhaseCongruency::featureBatch(const std::vector<cv::Mat>& _srcs, std::vector<cv::Mat>& _edges,
+                                   std::vector<cv::Mat>& _corners)
+{
+    const int count = static_cast<int>(_srcs.size());
+    _edges.resize(count);
+    _corners.resize(count);
+    if (count == 0)
+        return;
+
+    // Parallelism across images rather than within one: while one lane
+    // runs its forward transform another is in its inverse transforms
+    const int workers = std::min(workerCount(), count);
+    if (workers == 1)
+    {
+        for (int i = 0; i < count; i++)
+            feature(_srcs[i], _edges[i], _corners[i]);
+        return;
+    }
+
+    prepareLanes(workers, true);
+    parallel_for_(Range(0, workers), [&](const Range& range) {
+        for (int l = range.start; l < range.end; l++)
+            for (int i = l; i < count; i += workers)
+                lanes[l]->feature(_srcs[i], _edges[i], _corners[i]);
+    });
+}
+
+int PhaseCongruency::tileOverlap(size_t nscale, const PhaseCongruencyConst& pcc)
+{
+    const double maxWavelength = pcc.minwavelength * pow(pcc.mult, static_cast<double>(nscale) - 1.0);
+    return cvCeil(2.0 * maxWavelength);
+}
+
+void PhaseCongruency::featureTiled(cv::Size imageSize, const PhaseCongruencyTileReader& read,
+                                   const PhaseCongruencyTileWriter& write)
+{
+    PC_PROFILE_FRAME(frameProfiler(), frameDepth);
+    std::vector<double> noise;
+    featureTiles(imageSize, nullptr, noise, read, write);
+}
+
+// Runs fn(lane, tile core) for the tiles of the row-major grid listed in
+// selected, or all of them, with the lane's ws.tileInput holding the tile
+// and its margin. read is called under io, which fn locks to write.
+void PhaseCongruency::forEachTile(cv::Size imageSize, const std::vector<int>* selected,
+                                  const PhaseCongruencyTileReader& read, std::mutex& io,
+                                  const std::function<void(PhaseCongruency&, const cv::Rect&)>& fn)
+{
+    const int overlap = tileOverlap(nscale, pcc);
+    const cv::Size core(size.width - 2 * overlap, size.height - 2 * overlap);
+    CV_Assert(core.width > 0 && core.height > 0);
+
+    const int tilesX = (imageSize.width + core.width - 1) / core.width;
+    const int tiles = selected != nullptr ? static_cast<int>(selected->size())
+                                          : tilesX * ((imageSize.height + core.height - 1) / core.height);
+    const cv::Rect image(0, 0, imageSize.width, imageSize.height);
+    std::atomic<int> next(0);
+
+    // Only workerCount() tiles are in flight, so memory stays bounded by
+    // the lanes' workspaces whatever the image size
+    auto processTiles = [&](PhaseCongruency& lane) {
+        Workspace& lws = lane.ws;
+        for (int i = next++; i < tiles; i = next++)
+        {
+            const int t = selected != nullptr ? (*selected)[i] : i;
+            const cv::Rect coreRect = cv::Rect((t % tilesX) * core.width, (t / tilesX) * core.height,
+                                               core.width, core.height) & image;
+            const cv::Rect tileRect(coreRect.x - overlap, coreRect.y - overlap, size.width, size.height);
+            const cv::Rect readRect = tileRect & image;
+
+            {
+                std::lock_guard<std::mutex> lock(io);
+                read(readRect, lws.tileRead);
+            }
+            CV_Assert(lws.tileRead.size() == readRect.size() && lws.tileRead.channels() == 1);
+
+            // Outside the image the margin is mirrored, as is the part of
+            // the last row/column of tiles that lies beyond the image
+            copyMakeBorder(lws.tileRead, lws.tileInput,
+                           readRect.y - tileRect.y, tileRect.br().y - readRect.br().y,
+                           readRect.x - tileRect.x, tileRect.br().x - readRect.br().x,
+                           BORDER_REFLECT_101);
+
+            fn(lane, coreRect);
+        }
+    };
+
+    const int workers = std::min(workerCount(), tiles);
+    if (workers <= 1)
+    {
+        processTiles(*this);
+        return;
+    }
+
+    prepareLanes(workers, false);
+    parallel_for_(Range(0, workers), [&](const Range& range) {
+        for (int l = range.start; l < range.end; l++)
+            processTiles(*lanes[l]);
+    });
+}
+
+// The tiles listed in selected, or all of them. Every tile uses the same
+// per-orientation noise thresholds, so that the stitched maps do not step
+// at tile borders. If noise is empty, they are first estimated from the
+// finest-scale amplitudes of the whole image, with one more read of every
+// tile, and stored in noise.
+void PhaseCongruency::featureTiles(cv::Size imageSize, const std::vector<int>* selected, std::vector<double>& noise,
+                                   const PhaseCongruencyTileReader& read, const PhaseCongruencyTileWriter& write)
+{
+    const int overlap = tileOverlap(nscale, pcc);
+    std::mutex io;
+
+    if (noise.empty())
+    {
+        std::vector<double> total(norient, 0.0);
+        forEachTile(imageSize, nullptr, read, io, [&](PhaseCongruency& lane, const cv::Rect& coreRect) {
+            std::vector<double>& sums = lane.ws.tileNoiseSums;
+            lane.finestAmplitudeSums(lane.ws.tileInput, cv::Rect(overlap, overlap, coreRect.width, coreRect.height), sums);
+            std::lock_guard<std::mutex> lock(io);
+            for (size_t o = 0; o < norient; o++)
+                total[o] += sums[o];
+        });
+        noise.resize(norient);
+        for (size_t o = 0; o < norient; o++)
+            noise[o] = noiseThreshold(total[o] / imageSize.area(), nscale, pcc);
+    }
+
+    // Lanes pick the thresholds up in prepareLanes
+    fixedNoise = noise;
+    forEachTile(imageSize, selected, read, io, [&](PhaseCongruency& lane, const cv::Rect& coreRect) {
+        Workspace& lws = lane.ws;
+        lane.feature(lws.tileInput, lws.tileEdges, lws.tileCorners);
+
+        const cv::Rect inTile(overlap, overlap, coreRect.width, coreRect.height);
+        std::lock_guard<std::mutex> lock(io);
+        write(coreRect, lws.tileEdges(inTile), lws.tileCorners(inTile));
+    });
+    fixedNoise.clear();
+}
+
+double PhaseCongruency::featureIncremental(InputArray _src, OutputArray _edges, OutputArray _corners,
+                                           double threshold)
+{
+    PC_PROFILE_FRAME(frameProfiler(), frameDepth);
+    Mat src = _src.getMat();
+    CV_Assert(src.channels() == 1);
+
+    const int overlap = tileOverlap(nscale, pcc);
+    const cv::Size core(size.width - 2 * overlap, size.height - 2 * overlap);
+    CV_Assert(core.width > 0 && core.height > 0);
+    const int tilesX = (src.cols + core.width - 1) / core.width;
+    const int tilesY = (src.rows + core.height - 1) / core.height;
+    const cv::Rect image(0, 0, src.cols, src.rows);
+
+    const int tiles = tilesX * tilesY;
+    const bool fresh = ws.cachedEdges.size() != src.size() || ws.tileReference.size() != static_cast<size_t>(tiles) ||
+                       ws.tileReference[0].type() != src.type();
+    if (fresh)
+    {
+        ws.allocations += ensureMat(ws.cachedEdges, src.rows, src.cols, CV_8UC1, ws.allocatedBytes);
+        ws.allocations += ensureMat(ws.cachedCorners, src.rows, src.cols, CV_8UC1, ws.allocatedBytes);
+        ws.tileReference.assign(tiles, Mat());
+    }
+    ws.allocations += ensureMat(ws.changed, size.height, size.width, src.type(), ws.allocatedBytes);
+
+    // A change reaches the results of every tile whose core is within the
+    // filter support, overlap, of it. Each tile keeps the whole reach of
+    // the frame it was computed from, so drift below the threshold per
+    // frame still adds up, also where a recomputed neighbour's reach
+    // overlaps it.
+    auto reachOf = [&](const cv::Rect& coreRect) {
+        return cv::Rect(coreRect.x - overlap, coreRect.y - overlap,
+                        coreRect.width + 2 * overlap, coreRect.height + 2 * overlap) & image;
+    };
+    ws.dirtyTiles.clear();
+    double area = 0;
+    for (int t = 0; t < tiles; t++)
+    {
+        const cv::Rect coreRect = cv::Rect((t % tilesX) * core.width, (t / tilesX) * core.height,
+                                           core.width, core.height) & image;
+        bool dirty = fresh;
+        if (!dirty)
+        {
+            const cv::Rect reach = reachOf(coreRect);
+            Mat changed = ws.changed(cv::Rect(0, 0, reach.width, reach.height));
+            absdiff(src(reach), ws.tileReference[t], changed);
+            compare(changed, threshold, changed, CMP_GT);
+            dirty = countNonZero(changed) > 0;
+        }
+        if (dirty)
+        {
+            ws.dirtyTiles.push_back(t);
+            area += coreRect.area();
+        }
+    }
+
+    // The threshold is estimated only when every tile is recomputed
+    if (ws.dirtyTiles.size() == static_cast<size_t>(tiles))
+        ws.tileNoise.clear();
+    featureTiles(src.size(), &ws.dirtyTiles, ws.tileNoise,
+                 [&](const cv::Rect& region, cv::Mat& tile) { tile = src(region); },
+                 [&](const cv::Rect& region, const cv::Mat& edges, const cv::Mat& corners) {
+                     edges.copyTo(ws.cachedEdges(region));
+                     corners.copyTo(ws.cachedCorners(region));
+                     const int t = (region.y / core.height) * tilesX + region.x / core.width;
+                     src(reachOf(region)).copyTo(ws.tileReference[t]);
+                 });
+
+    ws.cachedEdges.copyTo(_edges);
+    ws.cachedCorners.copyTo(_corners);
+    return area / image.area();
+}
+
+void PhaseCongruency::resetIncremental()
+{
+    ws.tileReference.clear();
+    ws.tileNoise.clear();
+}
+
+void PhaseCongruency::featureWindow(InputArray _src, const cv::Rect& roi, OutputArray _edges, OutputArray _corners)
+{
+    Mat src = _src.getMat();
+    const int overlap = tileOverlap(nscale, pcc);
+    const cv::Rect image(0, 0, src.cols, src.rows);
+    CV_Assert(src.channels() == 1 && (roi & image) == roi && !roi.empty());
+    CV_Assert(roi.width + 2 * overlap <= size.width && roi.height + 2 * overlap <= size.height);
+
+    const cv::Rect window(roi.x - (size.width - roi.width) / 2, roi.y - (size.height - roi.height) / 2,
+                          size.width, size.height);
+    const cv::Rect readRect = window & image;
+    copyMakeBorder(src(readRect), ws.tileInput,
+                   readRect.y - window.y, window.br().y - readRect.br().y,
+                   readRect.x - window.x, window.br().x - readRect.br().x,
+                   BORDER_REFLECT_101);
+
+    feature(ws.tileInput, ws.tileEdges, ws.tileCorners);
+
+    const cv::Rect inWindow(roi.x - window.x, roi.y - window.y, roi.width, roi.height);
+    ws.tileEdges(inWindow).copyTo(_edges);
+    ws.tileCorners(inWindow).copyTo(_corners);
+}
+
+PhaseCongruencyConst::PhaseCongruencyConst()
+{
+    sigma = -1.0 / (2.0 * log(0.65) * log(0.65));
+}
+
+PhaseCongruencyConst::PhaseCongruencyConst(const PhaseCongruencyConst & _pcc)
+{
+    sigma = _pcc.sigma;
+    mult = _pcc.mult;
+    minwavelength = _pcc.minwavelength;
+    epsilon = _pcc.epsilon;
+    cutOff = _pcc.cutOff;
+    g = _pcc.g;
+    k = _pcc.k;
+}
+
+PhaseCongruencyConst& PhaseCongruencyConst::operator=(const PhaseCongruencyConst & _pcc)
+{
+    if (this == &_pcc) {
+        return *this;
+    }
+    sigma = _pcc.sigma;
+    mult = _pcc.mult;
+    minwavelength = _pcc.minwavelength;
+    epsilon = _pcc.epsilon;
+    cutOff = _pcc.cutOff;
+    g = _pcc.g;
+    k = _pcc.k;
+
+    return *this;
+}
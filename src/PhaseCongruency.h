@@ -0,0 +1,351 @@
+#pragma once
+
+// The phase congruency pipeline behind ofxPhaseCongruencyEdge: filter bank
+// cache, filtering, energy and moment stages on cv::Mat. Depends only on
+// OpenCV (core and imgproc), so it can be built and used without
+// openFrameworks; see CMakeLists.txt.
+
+#include "PhaseCongruencyFFT.h"
+#include "PhaseCongruencyProfiler.h"
+#include <opencv2/core.hpp>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+struct PhaseCongruencyConst {
+    double sigma;
+    double mult = 2.0;
+    double minwavelength = 1.5;
+    double epsilon = 0.0002;
+    double cutOff = 0.4;
+    double g = 10.0;
+    double k = 10.0;
+    PhaseCongruencyConst();
+    PhaseCongruencyConst(const PhaseCongruencyConst& _pcc);
+    PhaseCongruencyConst& operator=(const PhaseCongruencyConst& _pcc);
+};
+
+// Maps PhaseCongruencyResult can hold; or-ed together to select them
+enum PhaseCongruencyOutputs {
+    PC_MAX_MOMENT = 1,
+    PC_MIN_MOMENT = 2,
+    PC_ORIENTATION = 4,
+    PC_FEATURE_TYPE = 8,
+    PC_ALL_OUTPUTS = 15
+};
+
+// Unquantized outputs. Only the maps that were requested are filled in;
+// the others are left empty. The buffers are reused when the same result
+// is passed again.
+struct PhaseCongruencyResult {
+    cv::Mat maxMoment;          // CV_32F, edge strength, not clipped at 1
+    cv::Mat minMoment;          // CV_32F, corner strength
+    cv::Mat orientation;        // CV_32F, edge normal angle in image coordinates, (-pi/2, pi/2]
+    cv::Mat featureType;        // CV_32F, pi/2 bright line, -pi/2 dark line, 0 step edge
+    std::vector<cv::Mat> pc;    // per-orientation phase congruency, working depth; always filled
+};
+
+// A point of a thinned edge
+struct PhaseCongruencyEdgel {
+    cv::Point2f position;       // subpixel position
+    float orientation;          // edge normal angle, as PhaseCongruencyResult::orientation
+    float strength;             // max moment
+};
+
+// Corner detection: local maxima of the min moment
+struct PhaseCongruencyCornerParams {
+    float threshold = 0.1f;     // minimum min moment
+    int gridSize = 0;           // bucket cell size in pixels, 0 = no bucketing
+    int maxPerCell = 1;         // strongest corners kept per cell
+    int maxCorners = 0;         // strongest corners kept overall, 0 = all
+};
+
+// Tiled mode callbacks. The reader fills tile with the grayscale pixels of
+// region (any depth, region.size()); the writer receives the edge and
+// corner maps of region of the output. Both are called one at a time.
+typedef std::function<void(const cv::Rect& region, cv::Mat& tile)> PhaseCongruencyTileReader;
+typedef std::function<void(const cv::Rect& region, const cv::Mat& edges, const cv::Mat& corners)> PhaseCongruencyTileWriter;
+
+// Internals of PhaseCongruency: filter banks and workspaces
+namespace pcdetail
+{
+
+// Everything a log-Gabor bank depends on: the padded DFT size, the bank
+// shape, the working depth and the radial design parameters
+struct FilterBankKey
+{
+    int rows;
+    int cols;
+    int nscale;
+    int norient;
+    int depth;
+    double sigma;
+    double minwavelength;
+    double mult;
+    bool compact;
+
+    bool operator<(const FilterBankKey& other) const
+    {
+        return std::tie(rows, cols, nscale, norient, depth, sigma, minwavelength, mult, compact) <
+            std::tie(other.rows, other.cols, other.nscale, other.norient, other.depth,
+                     other.sigma, other.minwavelength, other.mult, other.compact);
+    }
+};
+
+// Log-Gabor bank in CCS-packed (half spectrum) layout, DC at the origin.
+// Each filter is split into its even (Hermitian) part and its odd part
+// pre-multiplied by -i, so both products with the spectrum of a real
+// image stay Hermitian and invert to real planes: the even/odd responses.
+//
+// A compact bank keeps only the factors of these filters: nscale radial
+// planes and norient even/odd angular planes, each spread over both slots
+// of every complex value. The products are formed on the fly while the
+// spectrum is multiplied (see compactSpectrumProduct).
+struct FilterBank
+{
+    FilterBankKey key;
+    std::vector<cv::Mat> even;
+    std::vector<cv::Mat> odd;
+    std::vector<cv::Mat> radial;
+    std::vector<cv::Mat> angularEven;
+    std::vector<cv::Mat> angularOdd;
+    std::shared_ptr<void> storage; // backing memory of a bank loaded from disk
+};
+
+struct AngularBank;
+
+// Per-worker scratch of calc and feature
+struct WorkerScratch
+{
+    cv::Mat products;               // spectrum times each filter of a batch, stacked planes
+    cv::Mat arg;                    // energy block: weighting argument
+    cv::Mat sumAn;                  // energy block: amplitude sum
+    cv::Mat moments;                // max and min moment of one row
+    cv::Mat window;                 // thinning: max moment rows y-1, y, y+1
+    cv::Mat normal;                 // thinning: edge normal of row y
+    std::vector<cv::KeyPoint> corners; // corner candidates of the band
+    std::vector<cv::Mat> levelProduct;  // pyramid mode: product at the size of each level
+    std::vector<cv::Mat> levelResponse; // ... and its inverse
+    cv::Mat fftScratch;             // half spectra of a batch for the FFT backend
+    std::vector<const float*> rowsF;  // row pointers into responses / PC maps
+    std::vector<const double*> rowsD;
+};
+
+// Buffers reused from frame to frame, so that steady-state processing
+// does not reallocate them. cv::dft, warpAffine and parallel_for_ still
+// allocate internally.
+struct Workspace
+{
+    cv::Mat padded;                    // zero-padded input, optimal DFT size
+    cv::Mat spectrum;                  // its CCS-packed forward transform
+    cv::Mat responses;                 // group * nscale padded even/odd planes, stacked
+    std::vector<cv::Mat> responseRe;   // ... each job's even plane
+    std::vector<cv::Mat> responseIm;   // ... and odd plane, right below it
+    std::vector<cv::Mat> eoRe;         // image-size views of the responses
+    std::vector<cv::Mat> eoIm;
+    std::vector<cv::Mat> pc;           // per-orientation PC for feature(src)
+    std::vector<cv::Mat> sumE;         // feature type: per-orientation even sum
+    std::vector<cv::Mat> sumO;         // ... and odd sum over scales
+    cv::Mat weights;                   // covariance weights, cos and sin per orientation
+    cv::Mat typedWeights;              // ... in the working depth
+    std::vector<WorkerScratch> workers;
+    cv::Mat labels;                    // thinning: 0 / weak / strong, then the mask
+    cv::Mat subpixel;                  // thinning: offset, angle, moment per edgel
+    std::vector<cv::Point> stack;      // thinning: hysteresis flood fill
+    std::vector<int> cellCounts;       // corners: keypoints per grid cell
+    cv::Mat tileRead;                  // tiled mode: tile as read from the source
+    cv::Mat tileInput;                 // ... with its border filled in
+    cv::Mat tileEdges;
+    cv::Mat tileCorners;
+    std::vector<double> tileNoiseSums; // ... finest-scale amplitude sums of the tile core
+    cv::Mat cachedEdges;               // incremental mode: the stitched results
+    cv::Mat cachedCorners;
+    std::vector<cv::Mat> tileReference; // ... per tile, its reach of the frame it came from
+    cv::Mat changed;                   // ... difference of a reach from its reference
+    std::vector<int> dirtyTiles;       // ... tiles to recompute
+    std::vector<double> tileNoise;     // ... noise threshold the cached results used
+    std::vector<int> scaleLevel;       // pyramid level k of each scale
+    std::vector<cv::Size> levelSize;   // cropped DFT size of each level
+    std::vector<cv::Mat> levelSpectrum; // ... the spectrum cropped to it, per frame
+    std::vector<cv::Mat> levelEven;    // ... filters of each decimated scale cropped to its
+    std::vector<cv::Mat> levelOdd;     //     level, by filter index (full banks)
+    std::vector<cv::Mat> levelRadial;  // ... compact banks: radial factor by scale
+    std::vector<cv::Mat> levelAngularEven; // and angular factors by (level, orientation)
+    std::vector<cv::Mat> levelAngularOdd;
+    std::shared_ptr<const FilterBank> levelBank; // bank and levels the filters were cropped for
+    std::vector<int> croppedLevel;
+    std::vector<std::shared_ptr<const PhaseCongruencyFFT> > fft; // transforms of each level
+    cv::Mat fftScratch;                // forward transform's backend scratch
+    size_t group = 0;                  // orientations filtered per pass
+    size_t batchJobs = 1;              // jobs whose inverses run as one batch
+    size_t allocations = 0;
+    size_t allocatedBytes = 0;         // total size of those allocations
+};
+
+} // namespace pcdetail
+
+class PhaseCongruency
+{
+public:
+    // _depth selects the working precision of the whole pipeline: CV_64F or CV_32F
+    // _compact stores only the radial and angular filter factors
+    PhaseCongruency(cv::Size _img_size, size_t _nscale, size_t _norient, int _depth = CV_64F,
+                    const PhaseCongruencyConst& _pcc = PhaseCongruencyConst(), bool _compact = false);
+    ~PhaseCongruency() {}
+    void setConst(PhaseCongruencyConst _pcc);
+    void calc(cv::InputArray _src, std::vector<cv::Mat> &_pc);
+    void feature(std::vector<cv::Mat> &_pc, cv::OutputArray _edges, cv::OutputArray _corners);
+    void feature(cv::InputArray _src, cv::OutputArray _edges, cv::OutputArray _corners);
+
+    // Float moments, orientation and feature type, each computed only if
+    // selected in outputs (PhaseCongruencyOutputs), in one pass
+    void compute(cv::InputArray _src, PhaseCongruencyResult& result, int outputs);
+
+    // Thin edges: non-maximum suppression of the max moment along the edge
+    // normal, fused with the moment pass, then hysteresis between low and
+    // high. mask gets 255 on edges; edgels, if not null, the subpixel points.
+    void thinEdges(cv::InputArray _src, double low, double high, cv::OutputArray _mask,
+                   std::vector<PhaseCongruencyEdgel>* edgels);
+
+    // Corners: 3x3 local maxima of the min moment, found in the moment pass
+    // by row bands, then grid bucketing and top-N on the candidates
+    void detectCorners(cv::InputArray _src, const PhaseCongruencyCornerParams& params,
+                       std::vector<cv::KeyPoint>& keypoints);
+
+    // Edges and corners of many same-size images. The images are spread
+    // over the workers, one whole image per worker at a time, each worker
+    // with its own workspace and all of them sharing this instance's bank.
+    void featureBatch(const std::vector<cv::Mat>& _srcs, std::vector<cv::Mat>& _edges,
+                      std::vector<cv::Mat>& _corners);
+
+    // Margin each tile needs around its core so that no filter response of
+    // the core sees the tile's wrap-around: twice the largest wavelength
+    static int tileOverlap(size_t nscale, const PhaseCongruencyConst& pcc);
+
+    // Edges and corners of an image of any size, tile by tile. This
+    // instance's size is the padded tile, its core is size - 2 * overlap.
+    // read and write are called one at a time; tiles run in parallel on
+    // workerCount() lanes, each with its own tile buffers. The noise
+    // threshold is estimated once for the whole image, in a first pass
+    // that reads every tile and filters it at the finest scale only.
+    void featureTiled(cv::Size imageSize, const PhaseCongruencyTileReader& read,
+                      const PhaseCongruencyTileWriter& write);
+
+    // Incremental tiled mode for mostly static scenes, on the tile grid of
+    // featureTiled. A tile is recomputed only if a pixel of its core or
+    // overlap differs by more than threshold from the frame its results
+    // came from; the others keep the results of earlier calls, held by this
+    // instance with each tile's reach of that frame. Returns the fraction of the image area recomputed. The
+    // first call, and the first after a size change, resetIncremental or
+    // any setter that changes the results, recomputes everything. Every
+    // tile uses the noise threshold of the last frame recomputed whole, so
+    // that recomputed tiles match their cached neighbours.
+    double featureIncremental(cv::InputArray _src, cv::OutputArray _edges, cv::OutputArray _corners,
+                              double threshold);
+    void resetIncremental();
+
+    // Edges and corners of the region roi of src, computed on a window of
+    // this instance's size centred on it. The window reads the image
+    // around roi and is mirrored beyond src, as a tile. roi must leave
+    // tileOverlap on every side of the window; the outputs are roi-sized.
+    void featureWindow(cv::InputArray _src, const cv::Rect& roi, cv::OutputArray _edges,
+                       cv::OutputArray _corners);
+
+    // Number of workers for the orientation/scale fan-out in calc;
+    // 0 uses the size of OpenCV's thread pool, 1 runs serially.
+    void setNumThreads(int _nthreads);
+
+    // Compact filters need (nscale + 2 * norient) planes instead of
+    // 2 * nscale * norient, for one extra multiply per spectrum element
+    void setCompactFilters(bool _compact);
+
+    // Invert coarse scales on a cropped spectrum, 2^k smaller per dimension,
+    // and upsample their responses; see pyramidTolerance
+    void setPyramid(bool _pyramid);
+
+    // DFT library for the forward and inverse transforms; plans are made
+    // per size once per process. See PhaseCongruencyFFT.h for which
+    // backends are compiled in.
+    void setFFTBackend(PhaseCongruencyFFTBackend _backend);
+
+    // Filter banks are shared by all instances with the same key, and the
+    // last few stay cached after their instances are gone. With a
+    // cache directory set, banks are also persisted there and memory-mapped
+    // on the next cold start instead of being regenerated, and FFTW keeps
+    // its wisdom there. The directory is created if needed; false if that
+    // fails, in which case nothing is persisted.
+    static bool setFilterCacheDirectory(const std::string& dir);
+    static void clearFilterCache();
+
+    // Number of times a workspace buffer had to be (re)allocated. Constant
+    // after the first frame unless the thread count changes.
+    size_t workspaceAllocations() const;
+
+    // Per-stage wall times, frames, and workspace allocations of this
+    // instance and its lanes. Times are only collected in builds with
+    // PHASECONGRUENCY_PROFILE defined; resetStats clears them (the
+    // allocation counts are kept). Tracing records every stage interval
+    // for writeTrace, in the Chrome trace-event JSON format.
+    PhaseCongruencyStats stats() const;
+    void resetStats();
+    void setTracing(bool enabled);
+    bool writeTrace(const std::string& path) const;
+
+    // Record into other's profiler from now on, so that its stats and
+    // trace also cover this instance. Workspace allocations stay per
+    // instance.
+    void shareProfiler(const PhaseCongruency& other);
+
+    // Null unless PHASECONGRUENCY_PROFILE is defined; shared with the
+    // lanes, and used by the wrapper for its own conversion stage
+    PhaseCongruencyProfiler* profiler() const { return stageProfiler.get(); }
+
+private:
+    PhaseCongruencyProfiler* frameProfiler() const { return countFrames ? profiler() : nullptr; }
+
+    // Lane of owner: same shape, bank and settings are set by prepareLanes
+    explicit PhaseCongruency(const PhaseCongruency* owner);
+
+    static std::shared_ptr<const pcdetail::FilterBank> acquireFilterBank(const pcdetail::FilterBankKey& key);
+    pcdetail::FilterBankKey filterBankKey() const;
+
+    int workerCount() const;
+    void prepareWorkspace();
+    void calc(cv::InputArray _src, std::vector<cv::Mat> &_pc, bool energySums);
+    void prepareLanes(size_t count, bool countFrames);
+    void forEachTile(cv::Size imageSize, const std::vector<int>* selected, const PhaseCongruencyTileReader& read,
+                     std::mutex& io, const std::function<void(PhaseCongruency&, const cv::Rect&)>& fn);
+    void featureTiles(cv::Size imageSize, const std::vector<int>* selected, std::vector<double>& noise,
+                      const PhaseCongruencyTileReader& read, const PhaseCongruencyTileWriter& write);
+    void finestAmplitudeSums(const cv::Mat& src, const cv::Rect& region, std::vector<double>& sums);
+    void spectrumProduct(const cv::Mat& dft_A, size_t index, int part, cv::Mat& dst) const;
+    void levelProduct(size_t index, int part, int level, cv::Mat& dst) const;
+    void filterResponse(const cv::Mat& dft_A, size_t index, pcdetail::WorkerScratch& scratch,
+                        cv::Mat& responseRe, cv::Mat& responseIm) const;
+    void filterJobs(const cv::Mat& dft_A, size_t o0, int first, int last, pcdetail::WorkerScratch& scratch);
+    void orientationEnergy(size_t o, const cv::Mat* eoRe, const cv::Mat* eoIm, pcdetail::WorkerScratch& scratch,
+                           cv::Mat& _pc, cv::Mat* sumE, cv::Mat* sumO) const;
+
+    cv::Size size;
+    size_t norient;
+    size_t nscale;
+    int depth;
+    bool compact;
+    bool pyramid = false;
+    int nthreads = 0;
+    PhaseCongruencyFFTBackend fftBackend = PC_FFT_OPENCV;
+
+    PhaseCongruencyConst pcc;
+    std::vector<double> fixedNoise; // tiled mode: whole-image noise threshold per orientation
+
+    std::shared_ptr<const pcdetail::FilterBank> bank;
+    std::shared_ptr<const pcdetail::AngularBank> angular; // kept by setConst for further radial rebuilds
+    pcdetail::Workspace ws;
+    std::vector<std::unique_ptr<PhaseCongruency>> lanes; // single-threaded batch workers
+    std::shared_ptr<PhaseCongruencyProfiler> stageProfiler;
+    bool countFrames = true;           // false for lanes running tiles
+    mutable int frameDepth = 0;        // frame scopes open on this instance
+};
@@ -0,0 +1,460 @@
+#include "PhaseCongruencyFFT.h"
+
+#include <complex>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <utility>
+
+#ifdef PHASECONGRUENCY_FFTW
+#include <fftw3.h>
+#endif
+#ifdef PHASECONGRUENCY_POCKETFFT
+#include "pocketfft_hdronly.hpp"
+#endif
+
+using namespace cv;
+
+// FFTW and pocketfft return the half spectrum of a real M x N image as
+// M x (N/2 + 1) complex values. In OpenCV's CCS layout the inner columns
+// k = 1 .. (N-1)/2 hold (re, im) at 2k-1, 2k. The DC column, and for even
+// N the Nyquist column (last), are themselves spectra of real columns and
+// are packed the same way down the rows: DC row, (re, im) pairs, and for
+// even M the real Nyquist row last.
+template<typename T>
+static void packCCS(const std::complex<T>* half, Mat& ccs)
+{
+    const int M = ccs.rows;
+    const int N = ccs.cols;
+    const int H = N / 2 + 1;
+
+    for (int j = 0; j < M; j++)
+    {
+        const std::complex<T>* h = half + static_cast<size_t>(j) * H;
+        T* row = ccs.ptr<T>(j);
+        for (int k = 1; k < (N + 1) / 2; k++)
+        {
+            row[2 * k - 1] = h[k].real();
+            row[2 * k] = h[k].imag();
+        }
+    }
+
+    for (int pass = 0; pass < (N % 2 == 0 ? 2 : 1); pass++)
+    {
+        const int k = pass == 0 ? 0 : N / 2;
+        const int c = pass == 0 ? 0 : N - 1;
+        ccs.ptr<T>(0)[c] = half[k].real();
+        for (int j = 1; j < (M + 1) / 2; j++)
+        {
+            const std::complex<T>& v = half[static_cast<size_t>(j) * H + k];
+            ccs.ptr<T>(2 * j - 1)[c] = v.real();
+            ccs.ptr<T>(2 * j)[c] = v.imag();
+        }
+        if (M % 2 == 0)
+            ccs.ptr<T>(M - 1)[c] = half[static_cast<size_t>(M / 2) * H + k].real();
+    }
+}
+
+// Inverse of packCCS. The DC and Nyquist columns are completed by Hermitian
+// symmetry, which is how cv::dft reads them for a real output.
+template<typename T>
+static void unpackCCS(const Mat& ccs, std::complex<T>* half)
+{
+    const int M = ccs.rows;
+    const int N = ccs.cols;
+    const int H = N / 2 + 1;
+
+    for (int j = 0; j < M; j++)
+    {
+        std::complex<T>* h = half + static_cast<size_t>(j) * H;
+        const T* row = ccs.ptr<T>(j);
+        for (int k = 1; k < (N + 1) / 2; k++)
+            h[k] = std::complex<T>(row[2 * k - 1], row[2 * k]);
+    }
+
+    for (int pass = 0; pass < (N % 2 == 0 ? 2 : 1); pass++)
+    {
+        const int k = pass == 0 ? 0 : N / 2;
+        const int c = pass == 0 ? 0 : N - 1;
+        half[k] = std::complex<T>(ccs.ptr<T>(0)[c], T(0));
+        for (int j = 1; j < (M + 1) / 2; j++)
+        {
+            const std::complex<T> v(ccs.ptr<T>(2 * j - 1)[c], ccs.ptr<T>(2 * j)[c]);
+            half[static_cast<size_t>(j) * H + k] = v;
+            half[static_cast<size_t>(M - j) * H + k] = std::conj(v);
+        }
+        if (M % 2 == 0)
+            half[static_cast<size_t>(M / 2) * H + k] = std::complex<T>(ccs.ptr<T>(M - 1)[c], T(0));
+    }
+}
+
+class OpenCVFFT : public PhaseCongruencyFFT
+{
+public:
+    OpenCVFFT(int rows, int cols, int depth) : PhaseCongruencyFFT(PC_FFT_OPENCV, rows, cols, depth) {}
+
+    void forward(const Mat& src, Mat& dst, Mat&) const override
+    {
+        dft(src, dst);
+    }
+
+    void inverse(const Mat& src, Mat& dst, Mat&) const override
+    {
+        dft(src, dst, DFT_INVERSE | DFT_REAL_OUTPUT);
+    }
+};
+
+// Backends that transform to and from the M x (N/2 + 1) half spectrum in
+// the caller's scratch buffer
+template<typename T>
+class HalfSpectrumFFT : public PhaseCongruencyFFT
+{
+public:
+    HalfSpectrumFFT(PhaseCongruencyFFTBackend kind, int rows, int cols)
+        : PhaseCongruencyFFT(kind, rows, cols, DataType<T>::depth) {}
+
+    cv::Size scratchSize(int count = 1) const override { return cv::Size(cols / 2 + 1, rows * count); }
+
+protected:
+    size_t halfSize() const { return static_cast<size_t>(rows) * (cols / 2 + 1); }
+
+    std::complex<T>* halfSpectrum(Mat& scratch, int count = 1) const
+    {
+        CV_Assert(scratch.isContinuous() && scratch.depth() == depth &&
+                  scratch.total() * scratch.elemSize() >= count * halfSize() * sizeof(std::complex<T>));
+        return reinterpret_cast<std::complex<T>*>(scratch.data);
+    }
+
+    void check(const Mat& src, int count = 1) const
+    {
+        CV_Assert(src.rows == rows * count && src.cols == cols && src.type() == type());
+    }
+
+    // Unpack count stacked CCS planes into consecutive half spectra
+    void unpackMany(const Mat& src, int count, std::complex<T>* half) const
+    {
+        for (int i = 0; i < count; i++)
+            unpackCCS<T>(src.rowRange(i * rows, (i + 1) * rows), half + i * halfSize());
+    }
+};
+
+#ifdef PHASECONGRUENCY_FFTW
+template<typename T> struct FFTW;
+
+template<> struct FFTW<double>
+{
+    typedef fftw_plan Plan;
+    typedef fftw_complex Complex;
+    static Plan planForward(int m, int n, double* in, Complex* out, unsigned flags) { return fftw_plan_dft_r2c_2d(m, n, in, out, flags); }
+    static Plan planInverse(int m, int n, Complex* in, double* out, unsigned flags) { return fftw_plan_dft_c2r_2d(m, n, in, out, flags); }
+    static Plan planInverseMany(int m, int n, int howmany, Complex* in, double* out, unsigned flags)
+    {
+        const int dims[2] = { m, n };
+        return fftw_plan_many_dft_c2r(2, dims, howmany, in, nullptr, 1, m * (n / 2 + 1), out, nullptr, 1, m * n, flags);
+    }
+    static void execute(Plan p, double* in, Complex* out) { fftw_execute_dft_r2c(p, in, out); }
+    static void execute(Plan p, Complex* in, double* out) { fftw_execute_dft_c2r(p, in, out); }
+    static void destroy(Plan p) { fftw_destroy_plan(p); }
+    static void* alloc(size_t bytes) { return fftw_malloc(bytes); }
+    static void release(void* p) { fftw_free(p); }
+    static int alignmentOf(void* p) { return fftw_alignment_of(static_cast<double*>(p)); }
+    static void importWisdom(const std::string& path) { fftw_import_wisdom_from_filename(path.c_str()); }
+    static void exportWisdom(const std::string& path) { fftw_export_wisdom_to_filename(path.c_str()); }
+    static const char* wisdomFile() { return "fftw_wisdom_f64"; }
+};
+
+template<> struct FFTW<float>
+{
+    typedef fftwf_plan Plan;
+    typedef fftwf_complex Complex;
+    static Plan planForward(int m, int n, float* in, Complex* out, unsigned flags) { return fftwf_plan_dft_r2c_2d(m, n, in, out, flags); }
+    static Plan planInverse(int m, int n, Complex* in, float* out, unsigned flags) { return fftwf_plan_dft_c2r_2d(m, n, in, out, flags); }
+    static Plan planInverseMany(int m, int n, int howmany, Complex* in, float* out, unsigned flags)
+    {
+        const int dims[2] = { m, n };
+        return fftwf_plan_many_dft_c2r(2, dims, howmany, in, nullptr, 1, m * (n / 2 + 1), out, nullptr, 1, m * n, flags);
+    }
+    static void execute(Plan p, float* in, Complex* out) { fftwf_execute_dft_r2c(p, in, out); }
+    static void execute(Plan p, Complex* in, float* out) { fftwf_execute_dft_c2r(p, in, out); }
+    static void destroy(Plan p) { fftwf_destroy_plan(p); }
+    static void* alloc(size_t bytes) { return fftwf_malloc(bytes); }
+    static void release(void* p) { fftwf_free(p); }
+    static int alignmentOf(void* p) { return fftwf_alignment_of(static_cast<float*>(p)); }
+    static void importWisdom(const std::string& path) { fftwf_import_wisdom_from_filename(path.c_str()); }
+    static void exportWisdom(const std::string& path) { fftwf_export_wisdom_to_filename(path.c_str()); }
+    static const char* wisdomFile() { return "fftw_wisdom_f32"; }
+};
+
+// FFTW's planner is not thread-safe; every plan is made and destroyed
+// under this lock
+static std::mutex fftwPlannerMutex;
+
+// FFTW_MEASURE plans, executed on the caller's arrays with the new-array
+// interface. cv::Mat data is 64-byte aligned, as the planning arrays are;
+// only views of stacked planes may not be.
+template<typename T>
+class FFTWFFT : public HalfSpectrumFFT<T>
+{
+    typedef FFTW<T> F;
+    typedef typename F::Complex Complex;
+    typedef typename F::Plan Plan;
+    using HalfSpectrumFFT<T>::rows;
+    using HalfSpectrumFFT<T>::cols;
+
+public:
+    FFTWFFT(int rows, int cols, const std::string& wisdomDir) : HalfSpectrumFFT<T>(PC_FFT_FFTW, rows, cols),
+        wisdom(wisdomDir.empty() ? std::string() : wisdomDir + "/" + F::wisdomFile())
+    {
+        std::lock_guard<std::mutex> lock(fftwPlannerMutex);
+        if (!wisdom.empty())
+            F::importWisdom(wisdom);
+
+        T* real = static_cast<T*>(F::alloc(static_cast<size_t>(rows) * cols * sizeof(T)));
+        Complex* spectrum = static_cast<Complex*>(F::alloc(this->halfSize() * sizeof(Complex)));
+        forwardPlan = F::planForward(rows, cols, real, spectrum, FFTW_MEASURE);
+        singleInverse = F::planInverse(rows, cols, spectrum, real, FFTW_MEASURE | FFTW_DESTROY_INPUT);
+        F::release(spectrum);
+        F::release(real);
+        CV_Assert(forwardPlan != nullptr && singleInverse != nullptr);
+
+        if (!wisdom.empty())
+            F::exportWisdom(wisdom);
+    }
+
+    ~FFTWFFT()
+    {
+        std::lock_guard<std::mutex> lock(fftwPlannerMutex);
+        F::destroy(forwardPlan);
+        F::destroy(singleInverse);
+        for (auto& plan : inversePlans)
+            F::destroy(plan.second);
+    }
+
+    // The out-of-place r2c plan preserves its input
+    void forward(const Mat& src, Mat& dst, Mat& scratch) const override
+    {
+        this->check(src);
+        CV_Assert(src.isContinuous());
+        std::complex<T>* half = this->halfSpectrum(scratch);
+        T* in = const_cast<T*>(src.ptr<T>());
+        CV_Assert(F::alignmentOf(in) == 0 && F::alignmentOf(half) == 0);
+        F::execute(forwardPlan, in, reinterpret_cast<Complex*>(half));
+
+        dst.create(rows, cols, src.type());
+        packCCS<T>(half, dst);
+    }
+
+    void inverse(const Mat& src, Mat& dst, Mat& scratch) const override
+    {
+        this->check(src);
+        std::complex<T>* half = this->halfSpectrum(scratch);
+        unpackCCS<T>(src, half);
+
+        dst.create(rows, cols, src.type());
+        CV_Assert(dst.isContinuous() && F::alignmentOf(half) == 0);
+        F::execute(inversePlan(1, F::alignmentOf(dst.data) == 0), reinterpret_cast<Complex*>(half), dst.ptr<T>());
+    }
+
+    // One howmany-plan over the planes, which lets FFTW loop (and
+    // vectorize) across them inside a single execute
+    void inverseMany(const Mat& src, Mat& dst, int count, Mat& scratch) const override
+    {
+        this->check(src, count);
+        CV_Assert(dst.rows == rows * count && dst.cols == cols && dst.type() == src.type());
+        std::complex<T>* half = this->halfSpectrum(scratch, count);
+        this->unpackMany(src, count, half);
+
+        CV_Assert(dst.isContinuous() && F::alignmentOf(half) == 0);
+        F::execute(inversePlan(count, F::alignmentOf(dst.data) == 0), reinterpret_cast<Complex*>(half), dst.ptr<T>());
+    }
+
+private:
+    // Inverse of count planes, planned on first use; callers use only a few
+    // counts. A plane stacked after an odd-sized one can start off FFTW's
+    // SIMD alignment, which needs an FFTW_UNALIGNED plan.
+    Plan inversePlan(int count, bool aligned) const
+    {
+        if (count == 1 && aligned)
+            return singleInverse;
+
+        std::lock_guard<std::mutex> lock(fftwPlannerMutex);
+        Plan& plan = inversePlans[std::make_pair(count, aligned)];
+        if (plan != nullptr)
+            return plan;
+
+        T* real = static_cast<T*>(F::alloc(static_cast<size_t>(count) * rows * cols * sizeof(T)));
+        Complex* spectrum = static_cast<Complex*>(F::alloc(count * this->halfSize() * sizeof(Complex)));
+        plan = F::planInverseMany(rows, cols, count, spectrum, real,
+                                  FFTW_MEASURE | FFTW_DESTROY_INPUT | (aligned ? 0 : FFTW_UNALIGNED));
+        F::release(spectrum);
+        F::release(real);
+        CV_Assert(plan != nullptr);
+
+        if (!wisdom.empty())
+            F::exportWisdom(wisdom);
+        return plan;
+    }
+
+    std::string wisdom;
+    Plan forwardPlan;
+    Plan singleInverse;
+    mutable std::map<std::pair<int, bool>, Plan> inversePlans;
+};
+#endif
+
+#ifdef PHASECONGRUENCY_POCKETFFT
+// pocketfft takes byte strides, so neither side needs to be continuous.
+// It keeps its own cache of the 1-D plans of each length.
+template<typename T>
+class PocketFFT : public HalfSpectrumFFT<T>
+{
+    using HalfSpectrumFFT<T>::rows;
+    using HalfSpectrumFFT<T>::cols;
+
+public:
+    PocketFFT(int rows, int cols) : HalfSpectrumFFT<T>(PC_FFT_POCKETFFT, rows, cols),
+        shape{ static_cast<size_t>(rows), static_cast<size_t>(cols) }, axes{ 0, 1 },
+        halfStride{ static_cast<ptrdiff_t>((cols / 2 + 1) * sizeof(std::complex<T>)),
+                    static_cast<ptrdiff_t>(sizeof(std::complex<T>)) }
+    {
+    }
+
+    void forward(const Mat& src, Mat& dst, Mat& scratch) const override
+    {
+        this->check(src);
+        std::complex<T>* half = this->halfSpectrum(scratch);
+        const pocketfft::stride_t stride{ static_cast<ptrdiff_t>(src.step[0]), static_cast<ptrdiff_t>(sizeof(T)) };
+        pocketfft::r2c<T>(shape, stride, halfStride, axes, pocketfft::FORWARD, src.ptr<T>(), half, T(1));
+
+        dst.create(rows, cols, src.type());
+        packCCS<T>(half, dst);
+    }
+
+    void inverse(const Mat& src, Mat& dst, Mat& scratch) const override
+    {
+        this->check(src);
+        std::complex<T>* half = this->halfSpectrum(scratch);
+        unpackCCS<T>(src, half);
+
+        dst.create(rows, cols, src.type());
+        const pocketfft::stride_t stride{ static_cast<ptrdiff_t>(dst.step[0]), static_cast<ptrdiff_t>(sizeof(T)) };
+        pocketfft::c2r<T>(shape, halfStride, stride, axes, pocketfft::BACKWARD, half, dst.ptr<T>(), T(1));
+    }
+
+    // A 3-D c2r over the last two axes; the planes are the leading axis
+    void inverseMany(const Mat& src, Mat& dst, int count, Mat& scratch) const override
+    {
+        this->check(src, count);
+        CV_Assert(dst.rows == rows * count && dst.cols == cols && dst.type() == src.type());
+        std::complex<T>* half = this->halfSpectrum(scratch, count);
+        this->unpackMany(src, count, half);
+
+        const pocketfft::shape_t manyShape{ static_cast<size_t>(count), shape[0], shape[1] };
+        const pocketfft::shape_t manyAxes{ 1, 2 };
+        const pocketfft::stride_t manyHalfStride{ static_cast<ptrdiff_t>(this->halfSize() * sizeof(std::complex<T>)),
+                                                  halfStride[0], halfStride[1] };
+        const pocketfft::stride_t stride{ static_cast<ptrdiff_t>(rows * dst.step[0]), static_cast<ptrdiff_t>(dst.step[0]),
+                                          static_cast<ptrdiff_t>(sizeof(T)) };
+        pocketfft::c2r<T>(manyShape, manyHalfStride, stride, manyAxes, pocketfft::BACKWARD, half, dst.ptr<T>(), T(1));
+    }
+
+private:
+    pocketfft::shape_t shape;
+    pocketfft::shape_t axes;
+    pocketfft::stride_t halfStride;
+};
+#endif
+
+void PhaseCongruencyFFT::inverseMany(const Mat& src, Mat& dst, int count, Mat& scratch) const
+{
+    CV_Assert(src.rows == rows * count && dst.rows == rows * count);
+    for (int i = 0; i < count; i++)
+    {
+        Mat plane = dst.rowRange(i * rows, (i + 1) * rows);
+        inverse(src.rowRange(i * rows, (i + 1) * rows), plane, scratch);
+    }
+}
+
+static std::mutex fftCacheMutex;
+static std::map<std::tuple<int, int, int, int>, std::shared_ptr<const PhaseCongruencyFFT> > fftCache;
+static std::string wisdomDirectory;
+
+bool PhaseCongruencyFFT::available(PhaseCongruencyFFTBackend backend)
+{
+    switch (backend)
+    {
+    case PC_FFT_OPENCV:
+        return true;
+#ifdef PHASECONGRUENCY_FFTW
+    case PC_FFT_FFTW:
+        return true;
+#endif
+#ifdef PHASECONGRUENCY_POCKETFFT
+    case PC_FFT_POCKETFFT:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+const char* PhaseCongruencyFFT::name(PhaseCongruencyFFTBackend backend)
+{
+    switch (backend)
+    {
+    case PC_FFT_OPENCV: return "opencv";
+    case PC_FFT_FFTW: return "fftw";
+    case PC_FFT_POCKETFFT: return "pocketfft";
+    default: return "unknown";
+    }
+}
+
+std::shared_ptr<const PhaseCongruencyFFT> PhaseCongruencyFFT::acquire(PhaseCongruencyFFTBackend backend,
+                                                                      int rows, int cols, int depth)
+{
+    CV_Assert(depth == CV_64F || depth == CV_32F);
+    if (!available(backend))
+        CV_Error(Error::StsNotImplemented, std::string("FFT backend not compiled in: ") + name(backend));
+
+    std::lock_guard<std::mutex> lock(fftCacheMutex);
+    std::shared_ptr<const PhaseCongruencyFFT>& fft = fftCache[std::make_tuple(static_cast<int>(backend), rows, cols, depth)];
+    if (fft)
+        return fft;
+
+    switch (backend)
+    {
+#ifdef PHASECONGRUENCY_FFTW
+    case PC_FFT_FFTW:
+        if (depth == CV_32F)
+            fft = std::make_shared<FFTWFFT<float> >(rows, cols, wisdomDirectory);
+        else
+            fft = std::make_shared<FFTWFFT<double> >(rows, cols, wisdomDirectory);
+        break;
+#endif
+#ifdef PHASECONGRUENCY_POCKETFFT
+    case PC_FFT_POCKETFFT:
+        if (depth == CV_32F)
+            fft = std::make_shared<PocketFFT<float> >(rows, cols);
+        else
+            fft = std::make_shared<PocketFFT<double> >(rows, cols);
+        break;
+#endif
+    default:
+        fft = std::make_shared<OpenCVFFT>(rows, cols, depth);
+        break;
+    }
+    return fft;
+}
+
+void PhaseCongruencyFFT::setWisdomDirectory(const std::string& dir)
+{
+    std::lock_guard<std::mutex> lock(fftCacheMutex);
+    wisdomDirectory = dir;
+}
+
+// Instances holding a transform keep it alive
+void PhaseCongruencyFFT::clearPlans()
+{
+    std::lock_guard<std::mutex> lock(fftCacheMutex);
+    fftCache.clear();
+}
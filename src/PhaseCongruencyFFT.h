@@ -0,0 +1,72 @@
+#pragma once
+
+// Real 2-D transforms of the pipeline behind a backend interface, so that
+// the DFT library can be chosen at setup. Every backend produces and
+// consumes OpenCV's CCS-packed half spectrum; filter banks and spectrum
+// products are the same whatever the backend.
+//
+// PC_FFT_OPENCV (cv::dft) is always available. PC_FFT_FFTW needs
+// PHASECONGRUENCY_FFTW defined and fftw3 and fftw3f linked.
+// PC_FFT_POCKETFFT needs PHASECONGRUENCY_POCKETFFT defined and
+// pocketfft_hdronly.hpp on the include path.
+
+#include <opencv2/core.hpp>
+#include <memory>
+#include <string>
+
+enum PhaseCongruencyFFTBackend {
+    PC_FFT_OPENCV,
+    PC_FFT_FFTW,
+    PC_FFT_POCKETFFT
+};
+
+class PhaseCongruencyFFT
+{
+public:
+    virtual ~PhaseCongruencyFFT() {}
+
+    // Real rows x cols src to its CCS-packed spectrum, as cv::dft
+    virtual void forward(const cv::Mat& src, cv::Mat& dst, cv::Mat& scratch) const = 0;
+
+    // CCS-packed spectrum to the real, unscaled inverse, as cv::dft with
+    // DFT_INVERSE | DFT_REAL_OUTPUT
+    virtual void inverse(const cv::Mat& src, cv::Mat& dst, cv::Mat& scratch) const = 0;
+
+    // count spectra stacked in src (count * rows rows) to their inverses,
+    // stacked the same way in dst, which must already have that shape. One
+    // batched transform where the backend has one, else one per plane.
+    virtual void inverseMany(const cv::Mat& src, cv::Mat& dst, int count, cv::Mat& scratch) const;
+
+    // Buffer each calling thread must pass to forward and inverse (count 1)
+    // or inverseMany, of type CV_MAKETYPE(depth, 2); empty if none is
+    // needed. A larger continuous buffer is fine, only its start is used.
+    virtual cv::Size scratchSize(int count = 1) const { (void)count; return cv::Size(); }
+
+    PhaseCongruencyFFTBackend backend() const { return kind; }
+    cv::Size size() const { return cv::Size(cols, rows); }
+    int type() const { return CV_MAKETYPE(depth, 1); }
+
+    // Planned transforms of one size and depth, shared by every caller:
+    // each backend plans a size once per process. The transforms are
+    // const and may run concurrently. Throws if the backend is not
+    // compiled in.
+    static std::shared_ptr<const PhaseCongruencyFFT> acquire(PhaseCongruencyFFTBackend backend,
+                                                             int rows, int cols, int depth);
+    static bool available(PhaseCongruencyFFTBackend backend);
+    static const char* name(PhaseCongruencyFFTBackend backend);
+
+    // FFTW wisdom is read from and written to this directory, so that
+    // FFTW_MEASURE planning is paid once per machine; "" disables it.
+    // Set by PhaseCongruency::setFilterCacheDirectory.
+    static void setWisdomDirectory(const std::string& dir);
+    static void clearPlans();
+
+protected:
+    PhaseCongruencyFFT(PhaseCongruencyFFTBackend _kind, int _rows, int _cols, int _depth)
+        : kind(_kind), rows(_rows), cols(_cols), depth(_depth) {}
+
+    PhaseCongruencyFFTBackend kind;
+    int rows;
+    int cols;
+    int depth;
+};
@@ -0,0 +1,384 @@
+#pragma once
+
+// Fused per-pixel kernels of the phase congruency pipeline.
+// Plain pointer code, vectorized with AVX-512 or AVX2 when the translation
+// unit is compiled for them (-mavx512f / -mavx2), scalar otherwise.
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace pckernel
+{
+
+template<typename T>
+struct ScalarOps
+{
+    typedef T V;
+    enum { lanes = 1 };
+
+    static V load(const T* p) { return *p; }
+    static void store(T* p, V v) { *p = v; }
+    static V set1(T v) { return v; }
+    static V add(V a, V b) { return a + b; }
+    static V sub(V a, V b) { return a - b; }
+    static V mul(V a, V b) { return a * b; }
+    static V div(V a, V b) { return a / b; }
+    static V max(V a, V b) { return a > b ? a : b; }
+    static V sqrt(V a) { return std::sqrt(a); }
+    static V abs(V a) { return std::abs(a); }
+};
+
+#if defined(__AVX512F__)
+template<typename T> struct Avx512Ops;
+
+template<>
+struct Avx512Ops<double>
+{
+    typedef __m512d V;
+    enum { lanes = 8 };
+
+    static V load(const double* p) { return _mm512_loadu_pd(p); }
+    static void store(double* p, V v) { _mm512_storeu_pd(p, v); }
+    static V set1(double v) { return _mm512_set1_pd(v); }
+    static V add(V a, V b) { return _mm512_add_pd(a, b); }
+    static V sub(V a, V b) { return _mm512_sub_pd(a, b); }
+    static V mul(V a, V b) { return _mm512_mul_pd(a, b); }
+    static V div(V a, V b) { return _mm512_div_pd(a, b); }
+    static V max(V a, V b) { return _mm512_max_pd(a, b); }
+    static V sqrt(V a) { return _mm512_sqrt_pd(a); }
+    static V abs(V a) { return _mm512_castsi512_pd(_mm512_and_si512(_mm512_castpd_si512(a), _mm512_set1_epi64(0x7fffffffffffffffLL))); }
+};
+
+template<>
+struct Avx512Ops<float>
+{
+    typedef __m512 V;
+    enum { lanes = 16 };
+
+    static V load(const float* p) { return _mm512_loadu_ps(p); }
+    static void store(float* p, V v) { _mm512_storeu_ps(p, v); }
+    static V set1(float v) { return _mm512_set1_ps(v); }
+    static V add(V a, V b) { return _mm512_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm512_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm512_mul_ps(a, b); }
+    static V div(V a, V b) { return _mm512_div_ps(a, b); }
+    static V max(V a, V b) { return _mm512_max_ps(a, b); }
+    static V sqrt(V a) { return _mm512_sqrt_ps(a); }
+    static V abs(V a) { return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(a), _mm512_set1_epi32(0x7fffffff))); }
+};
+
+template<typename T> using VecOps = Avx512Ops<T>;
+
+#elif defined(__AVX2__)
+template<typename T> struct Avx2Ops;
+
+template<>
+struct Avx2Ops<double>
+{
+    typedef __m256d V;
+    enum { lanes = 4 };
+
+    static V load(const double* p) { return _mm256_loadu_pd(p); }
+    static void store(double* p, V v) { _mm256_storeu_pd(p, v); }
+    static V set1(double v) { return _mm256_set1_pd(v); }
+    static V add(V a, V b) { return _mm256_add_pd(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+    static V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+    static V div(V a, V b) { return _mm256_div_pd(a, b); }
+    static V max(V a, V b) { return _mm256_max_pd(a, b); }
+    static V sqrt(V a) { return _mm256_sqrt_pd(a); }
+    static V abs(V a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+};
+
+template<>
+struct Avx2Ops<float>
+{
+    typedef __m256 V;
+    enum { lanes = 8 };
+
+    static V load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, V v) { _mm256_storeu_ps(p, v); }
+    static V set1(float v) { return _mm256_set1_ps(v); }
+    static V add(V a, V b) { return _mm256_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    static V div(V a, V b) { return _mm256_div_ps(a, b); }
+    static V max(V a, V b) { return _mm256_max_ps(a, b); }
+    static V sqrt(V a) { return _mm256_sqrt_ps(a); }
+    static V abs(V a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+};
+
+template<typename T> using VecOps = Avx2Ops<T>;
+
+#else
+template<typename T> using VecOps = ScalarOps<T>;
+#endif
+
+// Energy terms of Kovesi's phase congruency for the pixels [x, x + lanes)
+// of one row, given the even (re) and odd (im) responses of every scale.
+// Writes the noise-compensated energy, the sigmoid weighting argument
+// g * (cutOff - spread) and the amplitude sum.
+template<typename T, class Ops>
+inline void energyPixels(const T* const* re, const T* const* im, int nscale, int x,
+                         T noise, T epsilon, T cutOff, T g,
+                         T* energyOut, T* argOut, T* sumAnOut)
+{
+    typedef typename Ops::V V;
+
+    V sumRe = Ops::load(re[0] + x);
+    V sumIm = Ops::load(im[0] + x);
+    V sumAn = Ops::sqrt(Ops::add(Ops::mul(sumRe, sumRe), Ops::mul(sumIm, sumIm)));
+    V maxAn = sumAn;
+    for (int scale = 1; scale < nscale; scale++)
+    {
+        const V e = Ops::load(re[scale] + x);
+        const V o = Ops::load(im[scale] + x);
+        const V an = Ops::sqrt(Ops::add(Ops::mul(e, e), Ops::mul(o, o)));
+        sumAn = Ops::add(sumAn, an);
+        maxAn = Ops::max(an, maxAn);
+        sumRe = Ops::add(sumRe, e);
+        sumIm = Ops::add(sumIm, o);
+    }
+
+    // Mean phase direction
+    const V xEnergy = Ops::add(Ops::sqrt(Ops::add(Ops::mul(sumRe, sumRe), Ops::mul(sumIm, sumIm))), Ops::set1(epsilon));
+    const V meanE = Ops::div(sumRe, xEnergy);
+    const V meanO = Ops::div(sumIm, xEnergy);
+
+    V energy = Ops::set1(0);
+    for (int scale = 0; scale < nscale; scale++)
+    {
+        const V e = Ops::load(re[scale] + x);
+        const V o = Ops::load(im[scale] + x);
+        energy = Ops::sub(energy, Ops::abs(Ops::sub(Ops::mul(e, meanO), Ops::mul(o, meanE))));
+        energy = Ops::add(energy, Ops::mul(e, meanE));
+        energy = Ops::add(energy, Ops::mul(o, meanO));
+    }
+    energy = Ops::max(Ops::sub(energy, Ops::set1(noise)), Ops::set1(0));
+
+    // Frequency spread and the argument of the weighting sigmoid
+    V arg = Ops::mul(Ops::div(sumAn, Ops::add(maxAn, Ops::set1(epsilon))), Ops::set1(T(-1) / T(nscale)));
+    arg = Ops::mul(Ops::add(arg, Ops::set1(cutOff)), Ops::set1(g));
+
+    Ops::store(energyOut + x, energy);
+    Ops::store(argOut + x, arg);
+    Ops::store(sumAnOut + x, sumAn);
+}
+
+template<typename T>
+inline void energyRow(const T* const* re, const T* const* im, int nscale, int width,
+                      T noise, T epsilon, T cutOff, T g,
+                      T* energyOut, T* argOut, T* sumAnOut)
+{
+    typedef VecOps<T> Ops;
+
+    int x = 0;
+    for (; x + Ops::lanes <= width; x += Ops::lanes)
+        energyPixels<T, Ops>(re, im, nscale, x, noise, epsilon, cutOff, g, energyOut, argOut, sumAnOut);
+    for (; x < width; x++)
+        energyPixels<T, ScalarOps<T> >(re, im, nscale, x, noise, epsilon, cutOff, g, energyOut, argOut, sumAnOut);
+}
+
+// pc = energy / (weight * sumAn), weight = 1 + exp(arg); expArg holds
+// exp(arg). Zero where the denominator vanishes, as cv::divide does.
+template<typename T>
+inline void weightRow(T* pc, const T* expArg, const T* sumAn, int width)
+{
+    for (int x = 0; x < width; x++)
+    {
+        const T denom = (expArg[x] + T(1)) * sumAn[x];
+        pc[x] = denom != T(0) ? pc[x] / denom : T(0);
+    }
+}
+
+// Sum of the amplitudes sqrt(re^2 + im^2) of one row
+template<typename T>
+inline double magnitudeSum(const T* re, const T* im, int width)
+{
+    typedef VecOps<T> Ops;
+    typedef typename Ops::V V;
+
+    T lanes[Ops::lanes];
+    V acc = Ops::set1(0);
+    int x = 0;
+    for (; x + Ops::lanes <= width; x += Ops::lanes)
+    {
+        const V e = Ops::load(re + x);
+        const V o = Ops::load(im + x);
+        acc = Ops::add(acc, Ops::sqrt(Ops::add(Ops::mul(e, e), Ops::mul(o, o))));
+    }
+    Ops::store(lanes, acc);
+
+    double sum = 0;
+    for (int i = 0; i < Ops::lanes; i++)
+        sum += lanes[i];
+    for (; x < width; x++)
+        sum += std::sqrt(static_cast<double>(re[x]) * re[x] + static_cast<double>(im[x]) * im[x]);
+    return sum;
+}
+
+// Maximum and minimum moments of the phase congruency covariance for the
+// pixels [x, x + lanes) of one row. wx2/wy2/wxy hold, per orientation,
+// the covariance weights cos^2 * 2/n, sin^2 * 2/n and cos*sin * 4/n.
+template<typename T, class Ops>
+inline void momentPixels(const T* const* pc, int norient, const T* wx2, const T* wy2, const T* wxy,
+                         int x, T* maxOut, T* minOut)
+{
+    typedef typename Ops::V V;
+
+    V covx2 = Ops::set1(0);
+    V covy2 = Ops::set1(0);
+    V covxy = Ops::set1(0);
+    for (int o = 0; o < norient; o++)
+    {
+        const V p = Ops::load(pc[o] + x);
+        const V p2 = Ops::mul(p, p);
+        covx2 = Ops::add(covx2, Ops::mul(p2, Ops::set1(wx2[o])));
+        covy2 = Ops::add(covy2, Ops::mul(p2, Ops::set1(wy2[o])));
+        covxy = Ops::add(covxy, Ops::mul(p2, Ops::set1(wxy[o])));
+    }
+
+    const V diff = Ops::sub(covx2, covy2);
+    const V denom = Ops::sqrt(Ops::add(Ops::mul(diff, diff), Ops::mul(covxy, covxy)));
+    const V sum = Ops::add(covy2, covx2);
+    Ops::store(maxOut + x, Ops::add(sum, denom));
+    Ops::store(minOut + x, Ops::sub(sum, denom));
+}
+
+template<typename T>
+inline void momentRow(const T* const* pc, int norient, const T* wx2, const T* wy2, const T* wxy,
+                      int width, T* maxOut, T* minOut)
+{
+    typedef VecOps<T> Ops;
+
+    int x = 0;
+    for (; x + Ops::lanes <= width; x += Ops::lanes)
+        momentPixels<T, Ops>(pc, norient, wx2, wy2, wxy, x, maxOut, minOut);
+    for (; x < width; x++)
+        momentPixels<T, ScalarOps<T> >(pc, norient, wx2, wy2, wxy, x, maxOut, minOut);
+}
+
+// Principal orientation of the phase congruency covariance as the
+// direction of the edge normal in image coordinates (x right, y down),
+// radians in (-pi/2, pi/2]. 0.5 * atan2(covxy, covx2 - covy2) is the filter
+// angle, whose normal is a quarter turn away. Weights as for momentPixels.
+template<typename T>
+inline void orientationRow(const T* const* pc, int norient, const T* wx2, const T* wy2, const T* wxy,
+                           int width, float* out)
+{
+    for (int x = 0; x < width; x++)
+    {
+        T covx2 = 0, covy2 = 0, covxy = 0;
+        for (int o = 0; o < norient; o++)
+        {
+            const T p2 = pc[o][x] * pc[o][x];
+            covx2 += p2 * wx2[o];
+            covy2 += p2 * wy2[o];
+            covxy += p2 * wxy[o];
+        }
+        double angle = 0.5 * std::atan2(covxy, covx2 - covy2) + 1.5707963267948966;
+        if (angle > 1.5707963267948966)
+            angle -= 3.141592653589793;
+        out[x] = static_cast<float>(angle);
+    }
+}
+
+// Kovesi's feature type from the per-orientation sums of the even (sumE)
+// and odd (sumO) responses: atan2 of the total even energy and the norm of
+// the odd energy projected on the orientations. pi/2 on bright lines,
+// -pi/2 on dark lines, 0 on step edges.
+template<typename T>
+inline void featureTypeRow(const T* const* sumE, const T* const* sumO, int norient, const T* cosO, const T* sinO,
+                           int width, float* out)
+{
+    for (int x = 0; x < width; x++)
+    {
+        T even = 0, oddX = 0, oddY = 0;
+        for (int o = 0; o < norient; o++)
+        {
+            even += sumE[o][x];
+            oddX += sumO[o][x] * cosO[o];
+            oddY += sumO[o][x] * sinO[o];
+        }
+        out[x] = static_cast<float>(std::atan2(even, std::sqrt(oddX * oddX + oddY * oddY)));
+    }
+}
+
+// Non-maximum suppression of one row of the max moment across the edge.
+// rows[0..2] are the moment rows y-1, y, y+1 (zero outside the image),
+// normal the edge normal angle of row y. label gets 2 where the pixel is a
+// maximum at or above high, 1 where at or above low, 0 elsewhere. When
+// subpixel is not null it gets, per labelled pixel, the offset of the
+// parabola peak along the normal, the angle and the moment.
+template<typename T>
+inline void suppressRow(const T* const* rows, const float* normal, int width, T low, T high,
+                        unsigned char* label, float* subpixel)
+{
+    const T* mid = rows[1];
+    auto sample = [&](float fx, float fy) {
+        // bilinear, fy in [-1, 1] relative to the row, x clamped
+        const int x0 = static_cast<int>(std::floor(fx));
+        const int y0 = static_cast<int>(std::floor(fy));
+        const float ax = fx - x0;
+        const float ay = fy - y0;
+        const int xa = std::min(std::max(x0, 0), width - 1);
+        const int xb = std::min(std::max(x0 + 1, 0), width - 1);
+        const int ya = std::min(y0 + 1, 2);
+        const int yb = std::min(y0 + 2, 2);
+        const float top = (1 - ax) * rows[ya][xa] + ax * rows[ya][xb];
+        const float bottom = (1 - ax) * rows[yb][xa] + ax * rows[yb][xb];
+        return (1 - ay) * top + ay * bottom;
+    };
+
+    for (int x = 0; x < width; x++)
+    {
+        const T m = mid[x];
+        label[x] = 0;
+        if (m < low)
+            continue;
+
+        const float dx = std::cos(normal[x]);
+        const float dy = std::sin(normal[x]);
+        const float before = sample(x - dx, -dy);
+        const float after = sample(x + dx, dy);
+        if (m < before || m <= after)
+            continue;
+
+        label[x] = m >= high ? 2 : 1;
+        if (subpixel != nullptr)
+        {
+            const float curvature = before - 2 * static_cast<float>(m) + after;
+            const float offset = curvature < 0 ? 0.5f * (before - after) / curvature : 0.f;
+            subpixel[3 * x] = std::min(std::max(offset, -0.5f), 0.5f);
+            subpixel[3 * x + 1] = normal[x];
+            subpixel[3 * x + 2] = static_cast<float>(m);
+        }
+    }
+}
+
+// out = sum of count rows
+template<typename T>
+inline void sumRows(const T* const* rows, int count, int width, T* out)
+{
+    std::copy(rows[0], rows[0] + width, out);
+    for (int i = 1; i < count; i++)
+        for (int x = 0; x < width; x++)
+            out[x] += rows[i][x];
+}
+
+// v * 255 rounded to nearest and saturated, as convertTo(CV_8U, 255)
+template<typename T>
+inline void toU8Row(const T* src, int width, unsigned char* dst)
+{
+    for (int x = 0; x < width; x++)
+    {
+        const T v = src[x] * T(255);
+        dst[x] = v <= T(0) ? 0 : v >= T(255) ? 255 : static_cast<unsigned char>(std::lrint(v));
+    }
+}
+
+} // namespace pckernel
@@ -0,0 +1,156 @@
+#include "PhaseCongruencyProfiler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+const size_t PhaseCongruencyProfiler::percentileWindow;
+const size_t PhaseCongruencyProfiler::maxTraceEvents;
+
+PhaseCongruencyProfiler::PhaseCongruencyProfiler() : epoch(Clock::now())
+{
+}
+
+const char* PhaseCongruencyProfiler::stageName(PhaseCongruencyStage stage)
+{
+    static const char* names[PC_STAGE_COUNT] = { "frame", "fft", "filter", "energy", "moments", "conversion" };
+    return stage >= 0 && stage < PC_STAGE_COUNT ? names[stage] : "unknown";
+}
+
+// Small stable ids for the trace; called with the mutex held
+int PhaseCongruencyProfiler::threadIndex()
+{
+    const std::thread::id id = std::this_thread::get_id();
+    for (size_t i = 0; i < threads.size(); i++)
+        if (threads[i] == id)
+            return static_cast<int>(i);
+    threads.push_back(id);
+    return static_cast<int>(threads.size() - 1);
+}
+
+void PhaseCongruencyProfiler::record(PhaseCongruencyStage stage, Clock::time_point start, Clock::time_point end)
+{
+    const double ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    Samples& s = samples[stage];
+    if (s.window.size() < percentileWindow)
+        s.window.push_back(ms);
+    else
+        s.window[s.next] = ms;
+    s.next = (s.next + 1) % percentileWindow;
+    s.min = s.count == 0 ? ms : std::min(s.min, ms);
+    s.max = s.count == 0 ? ms : std::max(s.max, ms);
+    s.total += ms;
+    s.count++;
+
+    if (!tracing)
+        return;
+    TraceEvent event;
+    event.stage = stage;
+    event.thread = threadIndex();
+    event.start = std::chrono::duration_cast<std::chrono::microseconds>(start - epoch).count();
+    event.duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    if (events.size() < maxTraceEvents)
+        events.push_back(event);
+    else
+        events[nextEvent] = event;
+    nextEvent = (nextEvent + 1) % maxTraceEvents;
+}
+
+void PhaseCongruencyProfiler::setTracing(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    tracing = enabled;
+}
+
+// Nearest-rank percentile of sorted values
+static double percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty())
+        return 0;
+    const size_t rank = static_cast<size_t>(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+void PhaseCongruencyProfiler::fill(PhaseCongruencyStats& stats) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int i = 0; i < PC_STAGE_COUNT; i++)
+    {
+        const Samples& s = samples[i];
+        PhaseCongruencyStageStats& out = stats.stages[i];
+        out.count = s.count;
+        out.totalMs = s.total;
+        out.meanMs = s.count > 0 ? s.total / s.count : 0;
+        out.minMs = s.min;
+        out.maxMs = s.max;
+
+        std::vector<double> sorted(s.window);
+        std::sort(sorted.begin(), sorted.end());
+        out.p50Ms = percentile(sorted, 50);
+        out.p90Ms = percentile(sorted, 90);
+        out.p99Ms = percentile(sorted, 99);
+    }
+    stats.frames = samples[PC_STAGE_FRAME].count;
+    stats.enabled = true;
+}
+
+void PhaseCongruencyProfiler::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int i = 0; i < PC_STAGE_COUNT; i++)
+        samples[i] = Samples();
+    events.clear();
+    nextEvent = 0;
+    epoch = Clock::now();
+}
+
+// Chrome trace-event JSON ("X" complete events), for chrome://tracing or
+// Perfetto. Events are written in recording order.
+bool PhaseCongruencyProfiler::writeTrace(const std::string& path) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (file == nullptr)
+        return false;
+
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    const size_t first = events.size() < maxTraceEvents ? 0 : nextEvent;
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        const TraceEvent& e = events[(first + i) % events.size()];
+        std::fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"phasecongruency\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":0,\"tid\":%d}",
+                     i == 0 ? "" : ",", stageName(static_cast<PhaseCongruencyStage>(e.stage)),
+                     static_cast<long long>(e.start), static_cast<long long>(e.duration), e.thread);
+    }
+    std::fprintf(file, "\n]}\n");
+    return std::fclose(file) == 0;
+}
+
+PhaseCongruencyProfiler::Scope::Scope(PhaseCongruencyProfiler* _profiler, PhaseCongruencyStage _stage,
+                                      int* _frameDepth)
+    : profiler(_profiler), stage(_stage), frameDepth(_frameDepth), outerFrame(false)
+{
+    if (profiler == nullptr)
+        return;
+    if (frameDepth != nullptr)
+    {
+        outerFrame = (*frameDepth)++ == 0;
+        if (!outerFrame)
+            return;
+    }
+    start = Clock::now();
+}
+
+PhaseCongruencyProfiler::Scope::~Scope()
+{
+    if (profiler == nullptr)
+        return;
+    if (frameDepth != nullptr)
+    {
+        (*frameDepth)--;
+        if (!outerFrame)
+            return;
+    }
+    profiler->record(stage, start, Clock::now());
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+// Optional per-stage instrumentation of the phase congruency pipeline:
+// wall time per stage with running percentiles, frame counts and an
+// in-memory trace in the Chrome trace-event format. The timers are only
+// compiled in when PHASECONGRUENCY_PROFILE is defined; otherwise
+// PC_PROFILE_SCOPE expands to nothing, no profiler is created and all
+// stats stay zero.
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum PhaseCongruencyStage {
+    PC_STAGE_FRAME,         // one image through the core: feature, compute, thinEdges, ...
+    PC_STAGE_FFT,           // input conversion, padding and forward DFT
+    PC_STAGE_FILTER,        // spectrum products and inverse DFTs
+    PC_STAGE_ENERGY,        // noise estimate, energy and weighting
+    PC_STAGE_MOMENTS,       // covariance, moments and what is derived from them
+    PC_STAGE_CONVERSION,    // wrapper: ofImage/cv::Mat conversion, resize, texture upload
+    PC_STAGE_COUNT
+};
+
+struct PhaseCongruencyStageStats {
+    uint64_t count = 0;
+    double totalMs = 0;
+    double meanMs = 0;
+    double minMs = 0;
+    double maxMs = 0;
+    // Over the most recent PhaseCongruencyProfiler::percentileWindow samples
+    double p50Ms = 0;
+    double p90Ms = 0;
+    double p99Ms = 0;
+};
+
+struct PhaseCongruencyStats {
+    PhaseCongruencyStageStats stages[PC_STAGE_COUNT];
+    uint64_t frames = 0;            // images through the public entry points
+    uint64_t allocations = 0;       // workspace buffer (re)allocations
+    uint64_t bytesAllocated = 0;    // ... and their total size
+    bool enabled = false;           // built with PHASECONGRUENCY_PROFILE
+};
+
+class PhaseCongruencyProfiler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static const size_t percentileWindow = 1024;
+    static const size_t maxTraceEvents = 1 << 20;
+
+    PhaseCongruencyProfiler();
+
+    // Thread-safe; called from the worker threads of batches and tiles
+    void record(PhaseCongruencyStage stage, Clock::time_point start, Clock::time_point end);
+
+    // Keep every recorded interval for writeTrace. Off by default; events
+    // are held in memory, at most maxTraceEvents, the oldest dropped first
+    void setTracing(bool enabled);
+    bool writeTrace(const std::string& path) const;
+
+    // Fills the stage times and frame count of stats
+    void fill(PhaseCongruencyStats& stats) const;
+    void reset();
+
+    static const char* stageName(PhaseCongruencyStage stage);
+
+    // Times its scope into a stage; a null profiler records nothing. A
+    // frame scope counts its nesting in frameDepth, the calling instance's
+    // counter, and is recorded only at depth 0, so an entry point called
+    // by another one of the same instance counts once.
+    class Scope
+    {
+    public:
+        Scope(PhaseCongruencyProfiler* profiler, PhaseCongruencyStage stage, int* frameDepth = nullptr);
+        ~Scope();
+    private:
+        Scope(const Scope&);
+        Scope& operator=(const Scope&);
+        PhaseCongruencyProfiler* profiler;
+        PhaseCongruencyStage stage;
+        int* frameDepth;
+        bool outerFrame;
+        Clock::time_point start;
+    };
+
+private:
+    struct Samples
+    {
+        std::vector<double> window;    // ring of the latest durations, ms
+        size_t next = 0;
+        uint64_t count = 0;
+        double total = 0;
+        double min = 0;
+        double max = 0;
+    };
+
+    struct TraceEvent
+    {
+        int stage;
+        int thread;
+        int64_t start;                 // microseconds since the epoch
+        int64_t duration;
+    };
+
+    int threadIndex();
+
+    mutable std::mutex mutex;
+    Clock::time_point epoch;
+    Samples samples[PC_STAGE_COUNT];
+    bool tracing = false;
+    std::vector<TraceEvent> events;    // ring once maxTraceEvents is reached
+    size_t nextEvent = 0;
+    std::vector<std::thread::id> threads;
+};
+
+#ifdef PHASECONGRUENCY_PROFILE
+#define PC_PROFILE_CONCAT2(a, b) a##b
+#define PC_PROFILE_CONCAT(a, b) PC_PROFILE_CONCAT2(a, b)
+#define PC_PROFILE_SCOPE(profiler, stage) \
+    PhaseCongruencyProfiler::Scope PC_PROFILE_CONCAT(pcProfileScope, __LINE__)(profiler, stage)
+#define PC_PROFILE_FRAME(profiler, depth) \
+    PhaseCongruencyProfiler::Scope PC_PROFILE_CONCAT(pcProfileScope, __LINE__)(profiler, PC_STAGE_FRAME, &(depth))
+#else
+#define PC_PROFILE_SCOPE(profiler, stage) do {} while (0)
+#define PC_PROFILE_FRAME(profiler, depth) do {} while (0)
+#endif
@@ -0,0 +1,49 @@
+#pragma once
+
+// Bounded lock-free queue for exactly one producer thread and one consumer
+// thread. push and pop never block; they fail when the queue is full or
+// empty.
+
+#include <atomic>
+#include <cstddef>
+
+template<typename T, size_t N>
+class SpscQueue
+{
+public:
+    SpscQueue() : head(0), tail(0) {}
+
+    // Producer side
+    bool push(const T& value)
+    {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == N)
+            return false;
+        items[t % N] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    bool pop(T& value)
+    {
+        const size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+        value = items[h % N];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Only while neither side is in use
+    void clear()
+    {
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    T items[N];
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+};
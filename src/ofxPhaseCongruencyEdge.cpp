@@ -1,391 +1,60 @@
 #include "ofxPhaseCongruencyEdge.h"
-#include "ofxCv.h"
 
-using namespace cv;
 using namespace ofxCv;
 
-class PhaseCongruency
-{
-public:
-    PhaseCongruency(cv::Size _img_size, size_t _nscale, size_t _norient);
-    ~PhaseCongruency() {}
-    void setConst(PhaseCongruencyConst _pcc);
-    void calc(cv::InputArray _src, std::vector<cv::Mat> &_pc);
-    void feature(std::vector<cv::Mat> &_pc, cv::OutputArray _edges, cv::OutputArray _corners);
-    void feature(cv::InputArray _src, cv::OutputArray _edges, cv::OutputArray _corners);
-
-private:
-    cv::Size size;
-    size_t norient;
-    size_t nscale;
-
-    PhaseCongruencyConst pcc;
-
-    std::vector<cv::Mat> filter;
-};
-
-// Rearrange the quadrants of Fourier image so that the origin is at
-// the image center
-static void shiftDFT(InputArray _src, OutputArray _dst)
-{
-    Mat src = _src.getMat();
-    cv::Size size = src.size();
-
-    _dst.create(size, src.type());
-    auto dst = _dst.getMat();
-
-    const int cx = size.width / 2;
-    const int cy = size.height / 2; // image center
-
-    Mat s1 = src(cv::Rect(0, 0, cx, cy));
-    Mat s2 = src(cv::Rect(cx, 0, cx, cy));
-    Mat s3 = src(cv::Rect(cx, cy, cx, cy));
-    Mat s4 = src(cv::Rect(0, cy, cx, cy));
-
-    Mat d1 = dst(cv::Rect(0, 0, cx, cy));
-    Mat d2 = dst(cv::Rect(cx, 0, cx, cy));
-    Mat d3 = dst(cv::Rect(cx, cy, cx, cy));
-    Mat d4 = dst(cv::Rect(0, cy, cx, cy));
-
-    Mat tmp;
-    s3.copyTo(tmp);
-    s1.copyTo(d3);
-    tmp.copyTo(d1);
-
-    s4.copyTo(tmp);
-    s2.copyTo(d4);
-    tmp.copyTo(d2);
-}
-
-#define MAT_TYPE CV_64FC1
-#define MAT_TYPE_CNV CV_64F
-
-// Making a filter
-// src & dst arrays of equal size & type
-PhaseCongruency::PhaseCongruency(cv::Size _size, size_t _nscale, size_t _norient)
-{
-    size = _size;
-    nscale = _nscale;
-    norient = _norient;
-
-    filter.resize(nscale * norient);
-
-    const int dft_M = getOptimalDFTSize(_size.height);
-    const int dft_N = getOptimalDFTSize(_size.width);
-
-    Mat radius = Mat::zeros(dft_M, dft_N, MAT_TYPE);
-    Mat matAr[2];
-    matAr[0] = Mat::zeros(dft_M, dft_N, MAT_TYPE);
-    matAr[1] = Mat::zeros(dft_M, dft_N, MAT_TYPE);
-    Mat lp = Mat::zeros(dft_M, dft_N, MAT_TYPE);
-    Mat angular = Mat::zeros(dft_M, dft_N, MAT_TYPE);
-    std::vector<Mat> gabor(nscale);
-
-    //Matrix values contain *normalised* radius
-    // values ranging from 0 at the centre to
-    // 0.5 at the boundary.
-    int r;
-    const int dft_M_2 = dft_M / 2;
-    const int dft_N_2 = dft_N / 2;
-    if (dft_M > dft_N) r = dft_N_2;
-    else r = dft_M_2;
-    const double dr = 1.0 / static_cast<double>(r);
-    for (int row = dft_M_2 - r; row < dft_M_2 + r; row++)
-    {
-        auto radius_row = radius.ptr<double>(row);
-        for (int col = dft_N_2 - r; col < dft_N_2 + r; col++)
-        {
-            int m = (row - dft_M_2);
-            int n = (col - dft_N_2);
-            radius_row[col] = sqrt(static_cast<double>(m * m + n * n)) * dr;
-        }
-    }
-    lp = radius * 2.5;
-    pow(lp, 20.0, lp);
-    lp += Scalar::all(1.0);
-    radius.at<double>(dft_M_2, dft_N_2) = 1.0;
-    // The following implements the log-gabor transfer function.
-    double mt = 1.0f;
-    for (int scale = 0; scale < nscale; scale++)
-    {
-        const double wavelength = pcc.minwavelength * mt;
-        gabor[scale] = radius * wavelength;
-        log(gabor[scale], gabor[scale]);
-        pow(gabor[scale], 2.0, gabor[scale]);
-        gabor[scale] *= pcc.sigma;
-        exp(gabor[scale], gabor[scale]);
-        gabor[scale].at<double>(dft_M_2, dft_N_2) = 0.0;
-        divide(gabor[scale], lp, gabor[scale]);
-        mt = mt * pcc.mult;
-    }
-    const double angle_const = static_cast<double>(M_PI) / static_cast<double>(norient);
-    for (int ori = 0; ori < norient; ori++)
-    {
-        double angl = (double)ori * angle_const;
-        //Now we calculate the angular component that controls the orientation selectivity of the filter.
-        for (int i = 0; i < dft_M; i++)
-        {
-            auto angular_row = angular.ptr<double>(i);
-            for (int j = 0; j < dft_N; j++)
-            {
-                double m = atan2(-((double)j / (double)dft_N - 0.5), (double)i / (double)dft_M - 0.5);
-                double s = sin(m);
-                double c = cos(m);
-                m = s * cos(angl) - c * sin(angl);
-                double n = c * cos(angl) + s * sin(angl);
-                s = fabs(atan2(m, n));
-
-                angular_row[j] = (cos(min(s * (double)norient * 0.5, M_PI)) + 1.0) * 0.5;
-            }
-        }
-        for (int scale = 0; scale < nscale; scale++)
-        {
-            multiply(gabor[scale], angular, matAr[0]); //Product of the two components.
-            merge(matAr, 2, filter[nscale * ori + scale]);
-        }//scale
-    }//orientation
-    //Filter ready
-}
-
-void PhaseCongruency::setConst(PhaseCongruencyConst _pcc)
-{
-    pcc = _pcc;
-}
-
-//Phase congruency calculation
-void PhaseCongruency::calc(InputArray _src, std::vector<cv::Mat> &_pc)
-{
-    Mat src = _src.getMat();
-
-    CV_Assert(src.size() == size);
-
-    const int width = size.width, height = size.height;
-
-    Mat src64;
-    src.convertTo(src64, MAT_TYPE_CNV, 1.0 / 255.0);
-
-    const int dft_M_r = getOptimalDFTSize(src.rows) - src.rows;
-    const int dft_N_c = getOptimalDFTSize(src.cols) - src.cols;
-
-    _pc.resize(norient);
-    std::vector<Mat> eo(nscale);
-    Mat complex[2];
-    Mat sumAn;
-    Mat sumRe;
-    Mat sumIm;
-    Mat maxAn;
-    Mat xEnergy;
-    Mat tmp;
-    Mat tmp1;
-    Mat tmp2;
-    Mat energy = Mat::zeros(size, MAT_TYPE);
-
-    //expand input image to optimal size
-    Mat padded;
-    copyMakeBorder(src64, padded, 0, dft_M_r, 0, dft_N_c, BORDER_CONSTANT, Scalar::all(0));
-    Mat planes[] = { Mat_<double>(padded), Mat::zeros(padded.size(), MAT_TYPE_CNV) };
-
-    Mat dft_A;
-    merge(planes, 2, dft_A);         // Add to the expanded another plane with zeros
-    dft(dft_A, dft_A);            // this way the result may fit in the source matrix
-
-    shiftDFT(dft_A, dft_A);
-
-    for (unsigned o = 0; o < norient; o++)
-    {
-        double noise = 0;
-        for (unsigned scale = 0; scale < nscale; scale++)
-        {
-            Mat filtered;
-            mulSpectrums(dft_A, filter[nscale * o + scale], filtered, 0); // Convolution
-            dft(filtered, filtered, DFT_INVERSE);
-            filtered(cv::Rect(0, 0, width, height)).copyTo(eo[scale]);
-
-            split(eo[scale], complex);
-            Mat eo_mag;
-            magnitude(complex[0], complex[1], eo_mag);
-
-            if (scale == 0)
-            {
-                //here to do noise threshold calculation
-                auto tau = mean(eo_mag);
-                tau.val[0] = tau.val[0] / sqrt(log(4.0));
-                auto mt = 1.0 * pow(pcc.mult, nscale);
-                auto totalTau = tau.val[0] * (1.0 - 1.0 / mt) / (1.0 - 1.0 / pcc.mult);
-                auto m = totalTau * sqrt(M_PI / 2.0);
-                auto n = totalTau * sqrt((4 - M_PI) / 2.0);
-                noise = m + pcc.k * n;
-
-                eo_mag.copyTo(maxAn);
-                eo_mag.copyTo(sumAn);
-                complex[0].copyTo(sumRe);
-                complex[1].copyTo(sumIm);
-            }
-            else
-            {
-                add(sumAn, eo_mag, sumAn);
-                max(eo_mag, maxAn, maxAn);
-                add(sumRe, complex[0], sumRe);
-                add(sumIm, complex[1], sumIm);
-            }
-        } // next scale
-
-        magnitude(sumRe, sumIm, xEnergy);
-        xEnergy += pcc.epsilon;
-        divide(sumIm, xEnergy, sumIm);
-        divide(sumRe, xEnergy, sumRe);
-        energy.setTo(0);
-        for (int scale = 0; scale < nscale; scale++)
-        {
-            split(eo[scale], complex);
-
-            multiply(complex[0], sumIm, tmp1);
-            multiply(complex[1], sumRe, tmp2);
-
-            absdiff(tmp1, tmp2, tmp);
-            subtract(energy, tmp, energy);
-
-            multiply(complex[0], sumRe, complex[0]);
-            add(energy, complex[0], energy);
-            multiply(complex[1], sumIm, complex[1]);
-            add(energy, complex[1], energy);
-        } //next scale
-
-        energy -= Scalar::all(noise); // -noise
-        max(energy, 0.0, energy);
-        maxAn += pcc.epsilon;
-
-        divide(sumAn, maxAn, tmp, -1.0 / static_cast<double>(nscale));
-
-        tmp += pcc.cutOff;
-        tmp = tmp * pcc.g;
-        exp(tmp, tmp);
-        tmp += 1.0; // 1 / weight
-
-        //PC
-        multiply(tmp, sumAn, tmp);
-        divide(energy, tmp, _pc[o]);
-    }//orientation
-}
-
-//Build up covariance data for every point
-void PhaseCongruency::feature(std::vector<cv::Mat>& _pc, cv::OutputArray _edges, cv::OutputArray _corners)
-{
-    _edges.create(size, CV_8UC1);
-    _corners.create(size, CV_8UC1);
-    auto edges = _edges.getMat();
-    auto corners = _corners.getMat();
-
-    Mat covx2 = Mat::zeros(size, MAT_TYPE);
-    Mat covy2 = Mat::zeros(size, MAT_TYPE);
-    Mat covxy = Mat::zeros(size, MAT_TYPE);
-    Mat cos_pc, sin_pc, mul_pc;
-
-    const double angle_const = M_PI / static_cast<double>(norient);
-
-    for (unsigned o = 0; o < norient; o++)
-    {
-        auto angl = static_cast<double>(o) * angle_const;
-        cos_pc = _pc[o] * cos(angl);
-        sin_pc = _pc[o] * sin(angl);
-        multiply(cos_pc, sin_pc, mul_pc);
-        add(covxy, mul_pc, covxy);
-        pow(cos_pc, 2, cos_pc);
-        add(covx2, cos_pc, covx2);
-        pow(sin_pc, 2, sin_pc);
-        add(covy2, sin_pc, covy2);
-    } // next orientation
-
-    //Edges calculations
-    covx2 *= 2.0 / static_cast<double>(norient);
-    covy2 *= 2.0 / static_cast<double>(norient);
-    covxy *= 4.0 / static_cast<double>(norient);
-    Mat sub;
-    subtract(covx2, covy2, sub);
-
-    Mat denom;
-    magnitude(sub, covxy, denom); // denom;
-    Mat sum;
-    add(covy2, covx2, sum);
-
-    Mat minMoment, maxMoment;
-    subtract(sum, denom, minMoment);//m = (covy2 + covx2 - denom) / 2;          % ... and minimum moment
-    add(sum, denom, maxMoment); //M = (covy2+covx2 + denom)/2;          % Maximum moment
-
-    maxMoment.convertTo(edges, CV_8U, 255);
-    minMoment.convertTo(corners, CV_8U, 255);
-}
-
-//Build up covariance data for every point
-void PhaseCongruency::feature(InputArray _src, cv::OutputArray _edges, cv::OutputArray _corners)
-{
-    std::vector<cv::Mat> pc;
-    calc(_src, pc);
-    feature(pc, _edges, _corners);
-}
-
-PhaseCongruencyConst::PhaseCongruencyConst()
-{
-    sigma = -1.0 / (2.0 * log(0.65) * log(0.65));
-}
-
-PhaseCongruencyConst::PhaseCongruencyConst(const PhaseCongruencyConst & _pcc)
-{
-    sigma = _pcc.sigma;
-    mult = _pcc.mult;
-    minwavelength = _pcc.minwavelength;
-    epsilon = _pcc.epsilon;
-    cutOff = _pcc.cutOff;
-    g = _pcc.g;
-    k = _pcc.k;
-}
-
-PhaseCongruencyConst& PhaseCongruencyConst::operator=(const PhaseCongruencyConst & _pcc)
-{
-    if (this == &_pcc) {
-        return *this;
-    }
-    sigma = _pcc.sigma;
-    mult = _pcc.mult;
-    minwavelength = _pcc.minwavelength;
-    epsilon = _pcc.epsilon;
-    cutOff = _pcc.cutOff;
-    g = _pcc.g;
-    k = _pcc.k;
-
-    return *this;
-}
-
 // ofxPhaseCongruencyEdge implementation
-ofxPhaseCongruencyEdge::ofxPhaseCongruencyEdge() : isSetup(false), pc(nullptr) {
+ofxPhaseCongruencyEdge::ofxPhaseCongruencyEdge() : isSetup(false), pc(nullptr), tiledPc(nullptr), depth(CV_64F), numThreads(0), compactFilters(false), pyramid(false), fftBackend(PC_FFT_OPENCV), tracing(false), tileSize(1024), incremental(false), incrementalThreshold(8), recomputedFraction(1), asyncRunning(false) {
 }
 
 ofxPhaseCongruencyEdge::~ofxPhaseCongruencyEdge() {
+    stopAsync();
+    
+    if (tiledPc != nullptr) {
+        delete tiledPc;
+        tiledPc = nullptr;
+    }
+    
     if (pc != nullptr) {
         delete pc;
         pc = nullptr;
     }
 }
 
-void ofxPhaseCongruencyEdge::setup(int width, int height, int nscales, int norientations) {
+void ofxPhaseCongruencyEdge::setup(int width, int height, int nscales, int norientations, int precision) {
+    const bool wasAsync = stopAsync();
+    
     // Clean up previous instance if any
     if (pc != nullptr) {
         delete pc;
         pc = nullptr;
     }
+    if (tiledPc != nullptr) {
+        delete tiledPc;
+        tiledPc = nullptr;
+    }
+    roiPcs.clear();
     
     imgSize = cv::Size(width, height);
     nscale = nscales;
     norient = norientations;
+    depth = precision;
     
     // Create the PhaseCongruency instance
-    pc = new PhaseCongruency(imgSize, nscale, norient);
+    pc = new PhaseCongruency(imgSize, nscale, norient, depth, params, compactFilters);
+    pc->setNumThreads(numThreads);
+    pc->setPyramid(pyramid);
+    pc->setFFTBackend(fftBackend);
+    pc->setTracing(tracing);
     
     // Allocate output image buffers
     edgeImage.allocate(width, height, OF_IMAGE_GRAYSCALE);
     cornerImage.allocate(width, height, OF_IMAGE_GRAYSCALE);
     
     isSetup = true;
+    
+    if (wasAsync) {
+        startAsync();
+    }
 }
 
 void ofxPhaseCongruencyEdge::setParameters(PhaseCongruencyConst parameters) {
@@ -394,29 +63,180 @@ void ofxPhaseCongruencyEdge::setParameters(PhaseCongruencyConst parameters) {
         return;
     }
     
-    pc->setConst(parameters);
+    // Cheap when only k, g, cutOff or epsilon change; sigma, minwavelength
+    // and mult rebuild the radial filter components
+    const bool wasAsync = stopAsync();
+    const bool overlapChanged = PhaseCongruency::tileOverlap(nscale, parameters) !=
+                                PhaseCongruency::tileOverlap(nscale, params);
+    params = parameters;
+    pc->setConst(params);
+    
+    // The tile overlap depends on the wavelengths, and with it the tiled
+    // and ROI window sizes; rebuilt on next use when it changes
+    if (tiledPc != nullptr && overlapChanged) {
+        delete tiledPc;
+        tiledPc = nullptr;
+    } else if (tiledPc != nullptr) {
+        tiledPc->setConst(params);
+    }
+    if (overlapChanged) {
+        roiPcs.clear();
+    } else {
+        for (auto& roi : roiPcs) {
+            roi.second->setConst(params);
+        }
+    }
+    if (wasAsync) {
+        startAsync();
+    }
+}
+
+void ofxPhaseCongruencyEdge::setNumThreads(int threads) {
+    numThreads = threads;
+    roiPcs.clear();
+    
+    if (pc != nullptr) {
+        const bool wasAsync = stopAsync();
+        pc->setNumThreads(numThreads);
+        if (tiledPc != nullptr) {
+            tiledPc->setNumThreads(numThreads);
+        }
+        if (wasAsync) {
+            startAsync();
+        }
+    }
 }
 
-void ofxPhaseCongruencyEdge::process(const ofImage& image, ofImage& edgeImage, ofImage& cornerImage) {
-    // Convert to cv::Mat
-    cv::Mat inputMat = toCv(image);
+void ofxPhaseCongruencyEdge::setCompactFilters(bool compact) {
+    compactFilters = compact;
+    roiPcs.clear();
+    
+    if (pc != nullptr) {
+        const bool wasAsync = stopAsync();
+        pc->setCompactFilters(compactFilters);
+        if (tiledPc != nullptr) {
+            tiledPc->setCompactFilters(compactFilters);
+        }
+        if (wasAsync) {
+            startAsync();
+        }
+    }
+}
+
+void ofxPhaseCongruencyEdge::setPyramid(bool enabled) {
+    pyramid = enabled;
+    roiPcs.clear();
     
-    // Convert to grayscale if needed
-    if (inputMat.channels() > 1) {
-        cv::Mat grayMat;
-        cv::cvtColor(inputMat, grayMat, cv::COLOR_RGB2GRAY);
-        inputMat = grayMat;
+    if (pc != nullptr) {
+        const bool wasAsync = stopAsync();
+        pc->setPyramid(pyramid);
+        if (tiledPc != nullptr) {
+            tiledPc->setPyramid(pyramid);
+        }
+        if (wasAsync) {
+            startAsync();
+        }
+    }
+}
+
+void ofxPhaseCongruencyEdge::setFFTBackend(PhaseCongruencyFFTBackend backend) {
+    if (!PhaseCongruencyFFT::available(backend)) {
+        ofLogError("ofxPhaseCongruencyEdge") << "FFT backend " << PhaseCongruencyFFT::name(backend) << " is not compiled in";
+        return;
+    }
+    fftBackend = backend;
+    roiPcs.clear();
+    
+    if (pc != nullptr) {
+        const bool wasAsync = stopAsync();
+        pc->setFFTBackend(fftBackend);
+        if (tiledPc != nullptr) {
+            tiledPc->setFFTBackend(fftBackend);
+        }
+        if (wasAsync) {
+            startAsync();
+        }
+    }
+}
+
+void ofxPhaseCongruencyEdge::setFilterCacheDirectory(const std::string& dir) {
+    if (!PhaseCongruency::setFilterCacheDirectory(dir)) {
+        ofLogError("ofxPhaseCongruencyEdge") << "Cannot create filter cache directory " << dir << ", banks will not be persisted";
+    }
+}
+
+void ofxPhaseCongruencyEdge::clearFilterCache() {
+    PhaseCongruency::clearFilterCache();
+}
+
+size_t ofxPhaseCongruencyEdge::getWorkspaceAllocations() const {
+    size_t allocations = pc != nullptr ? pc->workspaceAllocations() : 0;
+    if (tiledPc != nullptr) {
+        allocations += tiledPc->workspaceAllocations();
+    }
+    for (const auto& roi : roiPcs) {
+        allocations += roi.second->workspaceAllocations();
+    }
+    return allocations;
+}
+
+PhaseCongruencyStats ofxPhaseCongruencyEdge::getStats() const {
+    if (pc == nullptr) {
+        return PhaseCongruencyStats();
     }
     
-    // Resize if necessary
-    if (inputMat.size() != imgSize) {
-        cv::resize(inputMat, inputMat, imgSize);
+    // The tiled and ROI instances record into pc's profiler; only their
+    // allocations are their own
+    PhaseCongruencyStats stats = pc->stats();
+    auto addAllocations = [&](const PhaseCongruency& instance) {
+        const PhaseCongruencyStats own = instance.stats();
+        stats.allocations += own.allocations;
+        stats.bytesAllocated += own.bytesAllocated;
+    };
+    if (tiledPc != nullptr) {
+        addAllocations(*tiledPc);
+    }
+    for (const auto& roi : roiPcs) {
+        addAllocations(*roi.second);
+    }
+    return stats;
+}
+
+void ofxPhaseCongruencyEdge::resetStats() {
+    if (pc != nullptr) {
+        const bool wasAsync = stopAsync();
+        pc->resetStats();
+        if (wasAsync) {
+            startAsync();
+        }
+    }
+}
+
+void ofxPhaseCongruencyEdge::setTracing(bool enabled) {
+    tracing = enabled;
+    if (pc != nullptr) {
+        const bool wasAsync = stopAsync();
+        pc->setTracing(tracing);
+        if (wasAsync) {
+            startAsync();
+        }
     }
+}
+
+bool ofxPhaseCongruencyEdge::writeTrace(const std::string& path) const {
+    return pc != nullptr && pc->writeTrace(path);
+}
+
+void ofxPhaseCongruencyEdge::process(const ofImage& image, ofImage& edgeImage, ofImage& cornerImage) {
+    // A view of the pixels; the gray conversion and resize happen in the
+    // member buffers of process(cv::Mat)
+    cv::Mat inputMat = toCv(image);
     
     // Process
     process(inputMat, edgeMat, cornerMat);
     
     // Convert results back to ofImage
+    PC_PROFILE_SCOPE(profiler(), PC_STAGE_CONVERSION);
     toOf(edgeMat, edgeImage);
     toOf(cornerMat, cornerImage);
     
@@ -429,24 +249,39 @@ void ofxPhaseCongruencyEdge::process(const cv::Mat& inputMat, cv::Mat& edgeMat,
         ofLogError("ofxPhaseCongruencyEdge") << "Setup must be called before processing";
         return;
     }
-    
-    // Make sure input is grayscale
-    cv::Mat grayMat;
-    if (inputMat.channels() > 1) {
-        cv::cvtColor(inputMat, grayMat, cv::COLOR_RGB2GRAY);
-    } else {
-        grayMat = inputMat;
+    if (asyncRunning) {
+        ofLogError("ofxPhaseCongruencyEdge") << "process is not available in async mode, use processAsync";
+        return;
     }
     
-    // Resize if necessary
-    if (grayMat.size() != imgSize) {
-        cv::resize(grayMat, grayMat, imgSize);
+    // Make sure input is grayscale; the conversion buffers are members so
+    // that repeated frames reuse them
+    cv::Mat input = inputMat;
+    {
+        PC_PROFILE_SCOPE(profiler(), PC_STAGE_CONVERSION);
+        if (input.channels() > 1) {
+            cv::cvtColor(input, grayMat, cv::COLOR_RGB2GRAY);
+            input = grayMat;
+        }
+        
+        // Resize if necessary
+        if (input.size() != imgSize) {
+            cv::resize(input, resizedMat, imgSize);
+            input = resizedMat;
+        }
     }
     
     // Call the Phase Congruency feature extraction
-    pc->feature(grayMat, edgeMat, cornerMat);
+    if (incremental) {
+        prepareTiled();
+        recomputedFraction = static_cast<float>(tiledPc->featureIncremental(input, edgeMat, cornerMat, incrementalThreshold));
+    } else {
+        pc->feature(input, edgeMat, cornerMat);
+        recomputedFraction = 1;
+    }
     
     // Save results to internal buffers
+    PC_PROFILE_SCOPE(profiler(), PC_STAGE_CONVERSION);
     toOf(edgeMat, this->edgeImage);
     toOf(cornerMat, this->cornerImage);
     
@@ -454,6 +289,403 @@ void ofxPhaseCongruencyEdge::process(const cv::Mat& inputMat, cv::Mat& edgeMat,
     this->cornerImage.update();
 }
 
+void ofxPhaseCongruencyEdge::process(const cv::Mat& inputMat, PhaseCongruencyResult& result, int outputs) {
+    if (!isSetup) {
+        ofLogError("ofxPhaseCongruencyEdge") << "Setup must be called before processing";
+        return;
+    }
+    if (asyncRunning) {
+        ofLogError("ofxPhaseCongruencyEdge") << "process is not available in async mode, use processAsync";
+        return;
+    }
+    
+    cv::Mat input = inputMat;
+    if (input.channels() > 1) {
+        cv::cvtColor(input, grayMat, cv::COLOR_RGB2GRAY);
+        input = grayMat;
+    }
+    if (input.size() != imgSize) {
+        cv::resize(input, resizedMat, imgSize);
+        input = resizedMat;
+    }
+    
+    pc->compute(input, result, outputs);
+}
+
+void ofxPhaseCongruencyEdge::processThinEdges(const cv::Mat& inputMat, cv::Mat& edgeMask, std::vector<PhaseCongruencyEdgel>* edgels, float lowThreshold, float highThreshold) {
+    if (!isSetup) {
+        ofLogError("ofxPhaseCongruencyEdge") << "Setup must be called before processing";
+        return;
+    }
+    if (asyncRunning) {
+        ofLogError("ofxPhaseCongruencyEdge") << "process is not available in async mode, use processAsync";
+        return;
+    }
+    
+    cv::Mat input = inputMat;
+    if (input.channels() > 1) {
+        cv::cvtColor(input, grayMat, cv::COLOR_RGB2GRAY);
+        input = grayMat;
+    }
+    if (input.size() != imgSize) {
+        cv::resize(input, resizedMat, imgSize);
+        input = resizedMat;
+    }
+    
+    pc->thinEdges(input, lowThreshold, highThreshold, edgeMask, edgels);
+}
+
+void ofxPhaseCongruencyEdge::detectCorners(const cv::Mat& inputMat, std::vector<cv::KeyPoint>& keypoints, const PhaseCongruencyCornerParams& cornerParams) {
+    if (!isSetup) {
+        ofLogError("ofxPhaseCongruencyEdge") << "Setup must be called before processing";
+        return;
+    }
+    if (asyncRunning) {
+        ofLogError("ofxPhaseCongruencyEdge") << "process is not available in async mode, use processAsync";
+        return;
+    }
+    
+    cv::Mat input = inputMat;
+    if (input.channels() > 1) {
+        cv::cvtColor(input, grayMat, cv::COLOR_RGB2GRAY);
+        input = grayMat;
+    }
+    if (input.size() != imgSize) {
+        cv::resize(input, resizedMat, imgSize);
+        input = resizedMat;
+    }
+    
+    pc->detectCorners(input, cornerParams, keypoints);
+}
+
+void ofxPhaseCongruencyEdge::setAsync(bool async) {
+    if (async) {
+        if (!isSetup) {
+            ofLogError("ofxPhaseCongruencyEdge") << "Setup must be called before enabling async mode";
+            return;
+        }
+        startAsync();
+    } else {
+        stopAsync();
+    }
+}
+
+// Start the worker with every frame slot and result buffer free. Returns
+// whether it was started by this call
+bool ofxPhaseCongruencyEdge::startAsync() {
+    if (asyncRunning) {
+        return false;
+    }
+    
+    inputReady.clear();
+    inputFree.clear();
+    resultReady.clear();
+    resultFree.clear();
+    for (int i = 0; i < asyncInputSlots; i++) {
+        inputFree.push(i);
+    }
+    for (int i = 0; i < asyncResultSlots; i++) {
+        resultFree.push(i);
+    }
+    
+    asyncRunning = true;
+    asyncThread = std::thread(&ofxPhaseCongruencyEdge::asyncLoop, this);
+    return true;
+}
+
+// Stop the worker after its current frame. Returns whether it was running
+bool ofxPhaseCongruencyEdge::stopAsync() {
+    if (!asyncRunning) {
+        return false;
+    }
+    
+    asyncRunning = false;
+    wakeAsync();
+    asyncThread.join();
+    return true;
+}
+
+// Called after pushing to a queue the worker waits on. Taking the mutex
+// orders the push before the worker's next check, so the wakeup is not lost.
+void ofxPhaseCongruencyEdge::wakeAsync() {
+    {
+        std::lock_guard<std::mutex> lock(asyncMutex);
+    }
+    asyncWake.notify_one();
+}
+
+void ofxPhaseCongruencyEdge::asyncLoop() {
+    int result = -1;
+    
+    while (true) {
+        int input;
+        {
+            std::unique_lock<std::mutex> lock(asyncMutex);
+            asyncWake.wait(lock, [&] { return !asyncRunning || inputReady.pop(input); });
+        }
+        if (!asyncRunning) {
+            return;
+        }
+        
+        // Only the newest submitted frame is worth processing
+        int newer;
+        while (inputReady.pop(newer)) {
+            inputFree.push(input);
+            input = newer;
+        }
+        
+        // Wait for the main thread to hand back a result buffer
+        if (result < 0) {
+            std::unique_lock<std::mutex> lock(asyncMutex);
+            asyncWake.wait(lock, [&] { return !asyncRunning || resultFree.pop(result); });
+        }
+        if (!asyncRunning) {
+            return;
+        }
+        
+        pc->feature(asyncInputs[input], asyncEdges[result], asyncCorners[result]);
+        
+        inputFree.push(input);
+        resultReady.push(result);
+        result = -1;
+    }
+}
+
+bool ofxPhaseCongruencyEdge::processAsync(const ofImage& image) {
+    return processAsync(toCv(image));
+}
+
+bool ofxPhaseCongruencyEdge::processAsync(const cv::Mat& inputMat) {
+    if (!asyncRunning) {
+        ofLogError("ofxPhaseCongruencyEdge") << "setAsync(true) must be called before processAsync";
+        return false;
+    }
+    
+    int slot;
+    if (!inputFree.pop(slot)) {
+        return false; // detector busy, drop the frame
+    }
+    
+    // Grayscale at the setup size, written straight into the frame slot
+    PC_PROFILE_SCOPE(profiler(), PC_STAGE_CONVERSION);
+    cv::Mat input = inputMat;
+    if (input.channels() > 1) {
+        cv::cvtColor(input, grayMat, cv::COLOR_RGB2GRAY);
+        input = grayMat;
+    }
+    if (input.size() != imgSize) {
+        cv::resize(input, asyncInputs[slot], imgSize);
+    } else {
+        input.copyTo(asyncInputs[slot]);
+    }
+    
+    inputReady.push(slot);
+    wakeAsync();
+    return true;
+}
+
+bool ofxPhaseCongruencyEdge::updateAsync() {
+    int result;
+    if (!asyncRunning || !resultReady.pop(result)) {
+        return false;
+    }
+    
+    // When update() fell behind the worker, only the newest result is
+    // shown; the older ones go straight back to the worker
+    int newer;
+    while (resultReady.pop(newer)) {
+        resultFree.push(result);
+        result = newer;
+    }
+    
+    // Texture upload happens here, on the caller's (GL) thread
+    PC_PROFILE_SCOPE(profiler(), PC_STAGE_CONVERSION);
+    toOf(asyncEdges[result], edgeImage);
+    toOf(asyncCorners[result], cornerImage);
+    edgeImage.update();
+    cornerImage.update();
+    
+    resultFree.push(result);
+    wakeAsync();
+    return true;
+}
+
+void ofxPhaseCongruencyEdge::processBatch(const std::vector<cv::Mat>& inputMats, std::vector<cv::Mat>& edgeMats, std::vector<cv::Mat>& cornerMats) {
+    if (!isSetup) {
+        ofLogError("ofxPhaseCongruencyEdge") << "Setup must be called before processing";
+        return;
+    }
+    if (asyncRunning) {
+        ofLogError("ofxPhaseCongruencyEdge") << "processBatch is not available in async mode";
+        return;
+    }
+    
+    // Bring every input to grayscale at the setup size; inputs that already
+    // are only get a header copy
+    batchInputs.resize(inputMats.size());
+    batchGray.resize(inputMats.size());
+    batchResized.resize(inputMats.size());
+    for (size_t i = 0; i < inputMats.size(); i++) {
+        batchInputs[i] = inputMats[i];
+        if (batchInputs[i].channels() > 1) {
+            cv::cvtColor(batchInputs[i], batchGray[i], cv::COLOR_RGB2GRAY);
+            batchInputs[i] = batchGray[i];
+        }
+        if (batchInputs[i].size() != imgSize) {
+            cv::resize(batchInputs[i], batchResized[i], imgSize);
+            batchInputs[i] = batchResized[i];
+        }
+    }
+    
+    pc->featureBatch(batchInputs, edgeMats, cornerMats);
+}
+
+void ofxPhaseCongruencyEdge::setIncremental(bool enabled, double threshold) {
+    incremental = enabled;
+    incrementalThreshold = threshold;
+    
+    // Re-enabling starts from a full frame
+    if (!incremental && tiledPc != nullptr) {
+        tiledPc->resetIncremental();
+    }
+}
+
+void ofxPhaseCongruencyEdge::setTileSize(int size) {
+    tileSize = size;
+    
+    if (tiledPc != nullptr) {
+        delete tiledPc;
+        tiledPc = nullptr;
+    }
+}
+
+void ofxPhaseCongruencyEdge::prepareTiled() {
+    // The padded tile is rounded up to a fast DFT size; the core grows with it
+    if (tiledPc == nullptr) {
+        const int overlap = PhaseCongruency::tileOverlap(nscale, params);
+        const cv::Size padded(cv::getOptimalDFTSize(tileSize + 2 * overlap),
+                              cv::getOptimalDFTSize(tileSize + 2 * overlap));
+        tiledPc = new PhaseCongruency(padded, nscale, norient, depth, params, compactFilters);
+        tiledPc->setNumThreads(numThreads);
+        tiledPc->setPyramid(pyramid);
+        tiledPc->setFFTBackend(fftBackend);
+        tiledPc->shareProfiler(*pc);
+    }
+}
+
+void ofxPhaseCongruencyEdge::processTiled(const cv::Size& imageSize, const PhaseCongruencyTileReader& read, const PhaseCongruencyTileWriter& write) {
+    if (!isSetup) {
+        ofLogError("ofxPhaseCongruencyEdge") << "Setup must be called before processing";
+        return;
+    }
+    
+    prepareTiled();
+    tiledPc->featureTiled(imageSize, read, write);
+}
+
+void ofxPhaseCongruencyEdge::processTiled(const cv::Mat& inputMat, cv::Mat& edgeMat, cv::Mat& cornerMat) {
+    cv::Mat input = inputMat;
+    if (input.channels() > 1) {
+        cv::cvtColor(input, grayMat, cv::COLOR_RGB2GRAY);
+        input = grayMat;
+    }
+    
+    edgeMat.create(input.size(), CV_8UC1);
+    cornerMat.create(input.size(), CV_8UC1);
+    processTiled(input.size(),
+                 [&](const cv::Rect& region, cv::Mat& tile) { tile = input(region); },
+                 [&](const cv::Rect& region, const cv::Mat& edges, const cv::Mat& corners) {
+                     edges.copyTo(edgeMat(region));
+                     corners.copyTo(cornerMat(region));
+                 });
+}
+
+// Window side for a ROI side: the side plus the overlap on both ends,
+// rounded up to a multiple of 64 so that similar sizes share an instance,
+// then to a fast DFT size
+static int roiWindowSide(int side, int overlap) {
+    return cv::getOptimalDFTSize((side + 2 * overlap + 63) / 64 * 64);
+}
+
+PhaseCongruency& ofxPhaseCongruencyEdge::roiInstance(const cv::Rect& roi) {
+    const int overlap = PhaseCongruency::tileOverlap(nscale, params);
+    const cv::Size window(roiWindowSide(roi.width, overlap), roiWindowSide(roi.height, overlap));
+    const std::pair<int, int> key(window.width, window.height);
+    
+    // Least recently used instances beyond maxRoiInstances are freed, so
+    // ROIs that keep changing size do not pile up windows and workspaces
+    for (auto it = roiPcs.begin(); it != roiPcs.end(); ++it) {
+        if (it->first == key) {
+            roiPcs.splice(roiPcs.begin(), roiPcs, it);
+            return *roiPcs.front().second;
+        }
+    }
+    
+    std::unique_ptr<PhaseCongruency> instance(new PhaseCongruency(window, nscale, norient, depth, params, compactFilters));
+    instance->setNumThreads(numThreads);
+    instance->setPyramid(pyramid);
+    instance->setFFTBackend(fftBackend);
+    instance->shareProfiler(*pc);
+    roiPcs.emplace_front(key, std::move(instance));
+    if (roiPcs.size() > maxRoiInstances) {
+        roiPcs.pop_back();
+    }
+    return *roiPcs.front().second;
+}
+
+void ofxPhaseCongruencyEdge::process(const cv::Mat& inputMat, const std::vector<cv::Rect>& rois,
+                                     std::vector<cv::Mat>& edgeMats, std::vector<cv::Mat>& cornerMats) {
+    if (!isSetup) {
+        ofLogError("ofxPhaseCongruencyEdge") << "Setup must be called before processing";
+        return;
+    }
+    
+    cv::Mat input = inputMat;
+    if (input.channels() > 1) {
+        cv::cvtColor(input, grayMat, cv::COLOR_RGB2GRAY);
+        input = grayMat;
+    }
+    
+    const cv::Rect image(0, 0, input.cols, input.rows);
+    edgeMats.resize(rois.size());
+    cornerMats.resize(rois.size());
+    for (size_t i = 0; i < rois.size(); i++) {
+        const cv::Rect roi = rois[i] & image;
+        if (roi.empty()) {
+            edgeMats[i].release();
+            cornerMats[i].release();
+            continue;
+        }
+        roiInstance(roi).featureWindow(input, roi, edgeMats[i], cornerMats[i]);
+    }
+}
+
+void ofxPhaseCongruencyEdge::process(const cv::Mat& inputMat, const std::vector<cv::Rect>& rois,
+                                     cv::Mat& edgeMat, cv::Mat& cornerMat) {
+    if (!isSetup) {
+        ofLogError("ofxPhaseCongruencyEdge") << "Setup must be called before processing";
+        return;
+    }
+    
+    const cv::Rect image(0, 0, inputMat.cols, inputMat.rows);
+    roiRects.resize(rois.size());
+    for (size_t i = 0; i < rois.size(); i++) {
+        roiRects[i] = rois[i] & image;
+    }
+    process(inputMat, roiRects, roiEdges, roiCorners);
+    
+    edgeMat.create(inputMat.size(), CV_8UC1);
+    cornerMat.create(inputMat.size(), CV_8UC1);
+    edgeMat.setTo(0);
+    cornerMat.setTo(0);
+    for (size_t i = 0; i < roiRects.size(); i++) {
+        if (!roiRects[i].empty()) {
+            roiEdges[i].copyTo(edgeMat(roiRects[i]));
+            roiCorners[i].copyTo(cornerMat(roiRects[i]));
+        }
+    }
+}
+
 void ofxPhaseCongruencyEdge::drawEdges(float x, float y, float width, float height) {
     if (!isSetup) {
         ofLogError("ofxPhaseCongruencyEdge") << "Setup must be called before drawing";
@@ -2,39 +2,150 @@
 
 #include "ofMain.h"
 #include "ofxCv.h"
+#include "PhaseCongruency.h"
+#include "SpscQueue.h"
+#include <atomic>
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
-struct PhaseCongruencyConst {
-    double sigma;
-    double mult = 2.0;
-    double minwavelength = 1.5;
-    double epsilon = 0.0002;
-    double cutOff = 0.4;
-    double g = 10.0;
-    double k = 10.0;
-    PhaseCongruencyConst();
-    PhaseCongruencyConst(const PhaseCongruencyConst& _pcc);
-    PhaseCongruencyConst& operator=(const PhaseCongruencyConst& _pcc);
-};
-
-class PhaseCongruency;
-
 class ofxPhaseCongruencyEdge
 {
 public:
     ofxPhaseCongruencyEdge();
     ~ofxPhaseCongruencyEdge();
     
-    // Initialize with image size, number of scales and orientations
-    void setup(int width, int height, int nscales = 4, int norientations = 6);
+    // Initialize with image size, number of scales and orientations.
+    // precision is the working depth of the pipeline: CV_64F or CV_32F
+    void setup(int width, int height, int nscales = 4, int norientations = 6, int precision = CV_64F);
     
-    // Set custom parameters
+    // Set custom parameters. They are kept across later calls to setup.
+    // Changing sigma, minwavelength or mult rebuilds this instance's filter
+    // bank; tuned banks are not added to the filter cache or its directory.
     void setParameters(PhaseCongruencyConst parameters);
     
+    // Number of worker threads for the filtering stage; 0 (default) uses
+    // OpenCV's thread pool size, 1 runs single-threaded
+    void setNumThreads(int threads);
+    
+    // Store only the nscale radial and norient angular filter factors and
+    // multiply them on the fly, instead of all nscale * norient filters.
+    // Uses far less memory per bank for slightly more work per frame
+    void setCompactFilters(bool compact);
+    
+    // Pyramid mode: coarse scales, whose filters have almost no energy at
+    // high frequencies, are inverted on a 2^k-decimated spectrum and
+    // upsampled. The saving grows with the number of scales; the edge maps
+    // stay close to the full-resolution ones
+    void setPyramid(bool enabled);
+    
+    // DFT library used for all transforms: PC_FFT_OPENCV (default),
+    // PC_FFT_FFTW or PC_FFT_POCKETFFT when compiled in (see
+    // PhaseCongruencyFFT.h). Plans are made once per size and process;
+    // FFTW's wisdom is kept in the filter cache directory
+    void setFFTBackend(PhaseCongruencyFFTBackend backend);
+    
+    // Filter banks are cached per process and shared by every instance with
+    // the same size, shape, precision and filter parameters. Setting a cache
+    // directory also persists them to disk; later cold starts memory-map the
+    // stored banks instead of regenerating them. The directory is created
+    // if it does not exist. Pass "" to disable.
+    static void setFilterCacheDirectory(const std::string& dir);
+    static void clearFilterCache();
+    
+    // Number of buffer (re)allocations made by the processing workspaces,
+    // including those of the tiled, incremental and ROI instances.
+    // Stays constant after the first frame for a fixed size and thread count
+    size_t getWorkspaceAllocations() const;
+    
+    // Per-stage timings (FFT, filtering, energy, moments, ofImage/cv::Mat
+    // conversion) with percentiles, frame count and workspace allocations.
+    // Timings are only collected when the addon is built with
+    // PHASECONGRUENCY_PROFILE defined and start over at every setup.
+    // They cover whole-frame, tiled, incremental and ROI processing alike.
+    // With tracing on, every stage interval is kept for writeTrace, which
+    // saves them as trace-event JSON (chrome://tracing, Perfetto)
+    PhaseCongruencyStats getStats() const;
+    void resetStats();
+    void setTracing(bool enabled);
+    bool writeTrace(const std::string& path) const;
+    
     // Compute phase congruency and extract features from image
     void process(const ofImage& image, ofImage& edgeImage, ofImage& cornerImage);
     void process(const cv::Mat& inputMat, cv::Mat& edgeMat, cv::Mat& cornerMat);
     
+    // Thin binary edges: non-maximum suppression of the max moment across
+    // the phase congruency orientation, then hysteresis between the low and
+    // high thresholds (max moment, nominally 0..1). edgeMask gets 255 on
+    // edge pixels; edgels, if given, the subpixel edge points
+    void processThinEdges(const cv::Mat& inputMat, cv::Mat& edgeMask, std::vector<PhaseCongruencyEdgel>* edgels = nullptr,
+                          float lowThreshold = 0.1f, float highThreshold = 0.3f);
+    
+    // Corners as keypoints: 3x3 local maxima of the float min moment above
+    // the threshold, optionally bucketed on a grid and limited to the
+    // strongest. response is the min moment
+    void detectCorners(const cv::Mat& inputMat, std::vector<cv::KeyPoint>& keypoints,
+                       const PhaseCongruencyCornerParams& cornerParams = PhaseCongruencyCornerParams());
+    
+    // Compute the float maps selected by outputs (PhaseCongruencyOutputs),
+    // without 8-bit quantization. The internal ofImages are not updated
+    void process(const cv::Mat& inputMat, PhaseCongruencyResult& result, int outputs = PC_MAX_MOMENT | PC_MIN_MOMENT);
+    
+    // Process many same-size images in one call. Images are distributed over
+    // the worker threads (see setNumThreads), one image per thread at a time,
+    // which scales much better than threading a single small image. The
+    // results are not copied to the internal ofImages
+    void processBatch(const std::vector<cv::Mat>& inputMats, std::vector<cv::Mat>& edgeMats, std::vector<cv::Mat>& cornerMats);
+    
+    // Tiled mode for images far larger than the setup size. The image is
+    // cut into tiles of about tileSize (default 1024) plus an overlap from
+    // the largest filter wavelength, the tiles run in parallel and the
+    // outputs are stitched. Memory is bounded by the tiles in flight, so a
+    // reader/writer pair can stream the image from and to disk. Uses the
+    // scales, orientations, precision and parameters of setup
+    void setTileSize(int size);
+    void processTiled(const cv::Size& imageSize, const PhaseCongruencyTileReader& read, const PhaseCongruencyTileWriter& write);
+    void processTiled(const cv::Mat& inputMat, cv::Mat& edgeMat, cv::Mat& cornerMat);
+    
+    // Incremental mode for fixed cameras: process runs on the tile grid of
+    // processTiled, but only recomputes tiles where a pixel of the tile or
+    // of its overlap changed by more than threshold gray levels since the
+    // tile was last computed. The other tiles keep their cached edges and
+    // corners. getRecomputedFraction is the share of the image recomputed
+    // by the last process call. A tile size of a few hundred pixels suits
+    // video frames better than the default
+    void setIncremental(bool enabled, double threshold = 8);
+    float getRecomputedFraction() const { return recomputedFraction; }
+    
+    // ROI mode: edges and corners only inside rois, on the input at its own
+    // size (no resize to the setup size). Each ROI is computed on a window
+    // of its size plus the tile overlap, rounded up to a 64-pixel bucket;
+    // one instance per bucket is kept, so ROIs of similar size share it
+    // and its filter bank. The first form writes the ROI areas of
+    // full-size outputs, zero elsewhere (a later ROI wins where two
+    // overlap); the second returns one map per ROI, in order. ROIs are
+    // clipped to the image
+    void process(const cv::Mat& inputMat, const std::vector<cv::Rect>& rois, cv::Mat& edgeMat, cv::Mat& cornerMat);
+    void process(const cv::Mat& inputMat, const std::vector<cv::Rect>& rois,
+                 std::vector<cv::Mat>& edgeMats, std::vector<cv::Mat>& cornerMats);
+    
+    // Asynchronous mode for live video. A background thread runs the
+    // detector at its own rate while the app keeps rendering: submit frames
+    // with processAsync (returns false and drops the frame while the
+    // detector is busy) and call updateAsync from update(), which uploads
+    // the newest finished result to the edge/corner images on the calling
+    // (GL) thread and returns true when there was one. The set* functions,
+    // setup, resetStats and setTracing briefly pause the worker; process,
+    // processBatch and the other single-image calls are refused meanwhile.
+    void setAsync(bool async);
+    bool isAsync() const { return asyncRunning; }
+    bool processAsync(const ofImage& image);
+    bool processAsync(const cv::Mat& inputMat);
+    bool updateAsync();
+    
     // Utility functions
     void drawEdges(float x, float y, float width, float height);
     void drawCorners(float x, float y, float width, float height);
@@ -45,13 +156,64 @@ public:
     ofImage& getCornerImage() { return cornerImage; }
     
 private:
+    bool startAsync();
+    bool stopAsync();
+    void prepareTiled();
+    PhaseCongruency& roiInstance(const cv::Rect& roi);
+    void asyncLoop();
+    void wakeAsync();
+    PhaseCongruencyProfiler* profiler() const { return pc != nullptr ? pc->profiler() : nullptr; }
+    
     PhaseCongruency* pc;
+    PhaseCongruency* tiledPc;
+    PhaseCongruencyConst params;
     bool isSetup;
     ofImage edgeImage;
     ofImage cornerImage;
     cv::Mat edgeMat;
     cv::Mat cornerMat;
+    cv::Mat grayMat;
+    cv::Mat resizedMat;
+    std::vector<cv::Mat> batchInputs;
+    std::vector<cv::Mat> batchGray;
+    std::vector<cv::Mat> batchResized;
     cv::Size imgSize;
     int nscale;
     int norient;
+    int depth;
+    int numThreads;
+    bool compactFilters;
+    bool pyramid;
+    PhaseCongruencyFFTBackend fftBackend;
+    bool tracing;
+    int tileSize;
+    bool incremental;
+    double incrementalThreshold;
+    float recomputedFraction;
+    
+    // ROI mode: instances by window width and height, most recently used
+    // first, at most maxRoiInstances; dropped whenever a setting changes
+    // and rebuilt on next use
+    static const size_t maxRoiInstances = 4;
+    std::list<std::pair<std::pair<int, int>, std::unique_ptr<PhaseCongruency> > > roiPcs;
+    std::vector<cv::Rect> roiRects;
+    std::vector<cv::Mat> roiEdges;
+    std::vector<cv::Mat> roiCorners;
+    
+    // Async mode: frame slots and result buffers are handed between the
+    // main thread and the worker by index through lock-free queues. The
+    // worker sleeps on asyncWake until the main thread hands it something.
+    static const int asyncInputSlots = 3;
+    static const int asyncResultSlots = 2;
+    std::thread asyncThread;
+    std::atomic<bool> asyncRunning;
+    std::mutex asyncMutex;
+    std::condition_variable asyncWake;
+    cv::Mat asyncInputs[asyncInputSlots];
+    cv::Mat asyncEdges[asyncResultSlots];
+    cv::Mat asyncCorners[asyncResultSlots];
+    SpscQueue<int, 4> inputReady;   // main -> worker
+    SpscQueue<int, 4> inputFree;    // worker -> main
+    SpscQueue<int, 4> resultReady;  // worker -> main
+    SpscQueue<int, 4> resultFree;   // main -> worker
 };
\ No newline at end of file